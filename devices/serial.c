@@ -1,7 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -37,6 +36,14 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable the receive and transmit FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear the receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear the transmit FIFO. */
+
+/* Depth of the 16550A transmit FIFO. */
+#define XMIT_FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -51,9 +58,23 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
-
+/* Data to be transmitted: a ring buffer filled by serial_putc()
+   and serial_putbuf() and drained by serial_interrupt() a FIFO's
+   worth at a time, so writers seldom wait on the line itself. */
+#define TXQ_SIZE 4096                   /* Must be a power of 2. */
+static uint8_t txq_buf[TXQ_SIZE];
+static size_t txq_head;                 /* Total bytes ever queued. */
+static size_t txq_tail;                 /* Total bytes ever dequeued. */
+
+/* A writer that found the queue full sleeps on TXQ_SPACE until
+   serial_interrupt() has drained half of it. */
+static struct semaphore txq_space;
+static bool txq_waiting;
+
+static bool txq_empty (void);
+static bool txq_full (void);
+static void txq_putc (uint8_t);
+static uint8_t txq_getc (void);
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
@@ -70,7 +91,7 @@ init_poll (void) {
 	outb (FCR_REG, 0);                    /* Disable FIFO. */
 	set_serial (115200);                  /* 115.2 kbps, N-8-1. */
 	outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-	intq_init (&txq);
+	sema_init (&txq_space, 0);
 	mode = POLL;
 }
 
@@ -86,6 +107,7 @@ serial_init_queue (void) {
 	ASSERT (mode == POLL);
 
 	intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+	outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
 	mode = QUEUE;
 	old_level = intr_disable ();
 	write_ier ();
@@ -95,27 +117,46 @@ serial_init_queue (void) {
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) {
+	serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port, disabling
+   interrupts once for the whole buffer rather than once per
+   byte. */
+void
+serial_putbuf (const void *buffer, size_t n) {
+	const uint8_t *p = buffer;
 	enum intr_level old_level = intr_disable ();
 
 	if (mode != QUEUE) {
 		/* If we're not set up for interrupt-driven I/O yet,
-		   use dumb polling to transmit a byte. */
+		   use dumb polling to transmit. */
 		if (mode == UNINIT)
 			init_poll ();
-		putc_poll (byte);
+		while (n-- > 0)
+			putc_poll (*p++);
 	} else {
-		/* Otherwise, queue a byte and update the interrupt enable
-		   register. */
-		if (old_level == INTR_OFF && intq_full (&txq)) {
-			/* Interrupts are off and the transmit queue is full.
-			   If we wanted to wait for the queue to empty,
-			   we'd have to reenable interrupts.
-			   That's impolite, so we'll send a character via
-			   polling instead. */
-			putc_poll (intq_getc (&txq));
+		while (n > 0) {
+			if (txq_full ()) {
+				if (old_level == INTR_OFF || intr_context ()) {
+					/* Interrupts are off and the transmit queue is
+					   full.  If we wanted to wait for the queue to
+					   empty, we'd have to reenable interrupts.
+					   That's impolite, so we'll send a character
+					   via polling instead. */
+					putc_poll (txq_getc ());
+				} else {
+					/* Sleep until the interrupt handler has made
+					   room. */
+					txq_waiting = true;
+					write_ier ();
+					sema_down (&txq_space);
+				}
+				continue;
+			}
+			txq_putc (*p++);
+			n--;
 		}
-
-		intq_putc (&txq, byte);
 		write_ier ();
 	}
 
@@ -127,8 +168,8 @@ serial_putc (uint8_t byte) {
 void
 serial_flush (void) {
 	enum intr_level old_level = intr_disable ();
-	while (!intq_empty (&txq))
-		putc_poll (intq_getc (&txq));
+	while (!txq_empty ())
+		putc_poll (txq_getc ());
 	intr_set_level (old_level);
 }
 
@@ -171,7 +212,7 @@ write_ier (void) {
 
 	/* Enable transmit interrupt if we have any characters to
 	   transmit. */
-	if (!intq_empty (&txq))
+	if (!txq_empty ())
 		ier |= IER_XMIT;
 
 	/* Enable receive interrupt if we have room to store any
@@ -205,11 +246,50 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
 		input_putc (inb (RBR_REG));
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+	/* Once the hardware's transmit FIFO has emptied, refill it in
+	   one go from the transmit queue. */
+	if ((inb (LSR_REG) & LSR_THRE) != 0) {
+		int i;
+
+		for (i = 0; i < XMIT_FIFO_SIZE && !txq_empty (); i++)
+			outb (THR_REG, txq_getc ());
+	}
+
+	/* Wake a writer waiting for room once half the queue is free. */
+	if (txq_waiting && txq_head - txq_tail <= TXQ_SIZE / 2) {
+		txq_waiting = false;
+		sema_up (&txq_space);
+	}
 
 	/* Update interrupt enable register based on queue status. */
 	write_ier ();
 }
+
+/* Returns true if the transmit queue is empty. */
+static bool
+txq_empty (void) {
+	return txq_head == txq_tail;
+}
+
+/* Returns true if the transmit queue is full. */
+static bool
+txq_full (void) {
+	return txq_head - txq_tail == TXQ_SIZE;
+}
+
+/* Adds BYTE to the transmit queue, which must not be full. */
+static void
+txq_putc (uint8_t byte) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!txq_full ());
+	txq_buf[txq_head++ % TXQ_SIZE] = byte;
+}
+
+/* Removes and returns the oldest byte in the transmit queue,
+   which must not be empty. */
+static uint8_t
+txq_getc (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!txq_empty ());
+	return txq_buf[txq_tail++ % TXQ_SIZE];
+}
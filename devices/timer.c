@@ -8,6 +8,9 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include <stdlib.h>
+#ifdef USERPROG
+#include "userprog/vdso.h"
+#endif
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -156,6 +159,9 @@ timer_print_stats (void) {
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
 	ticks++;
+#ifdef USERPROG
+	vdso_tick (ticks);
+#endif
 	thread_tick ();
     thread_wakeup(get_sleep_list(), ticks);
 }
@@ -20,10 +20,21 @@ struct dir_entry {
 };
 
 /* Creates a directory with space for ENTRY_CNT entries in the
- * given SECTOR.  Returns true if successful, false on failure. */
+ * given SECTOR of FS, whose ".." entry refers to the directory in
+ * PARENT.  Returns true if successful, false on failure. */
 bool
-dir_create (disk_sector_t sector, size_t entry_cnt) {
-	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+dir_create (struct filesys *fs, disk_sector_t sector, disk_sector_t parent,
+		size_t entry_cnt) {
+	struct dir *dir;
+	bool success;
+
+	if (!inode_create (fs, sector, entry_cnt * sizeof (struct dir_entry),
+				INODE_DIR))
+		return false;
+	dir = dir_open (inode_open (fs, sector));
+	success = dir != NULL && dir_add (dir, "..", parent);
+	dir_close (dir);
+	return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -32,6 +43,7 @@ struct dir *
 dir_open (struct inode *inode) {
 	struct dir *dir = calloc (1, sizeof *dir);
 	if (inode != NULL && dir != NULL) {
+		inode_set_journaled (inode);
 		dir->inode = inode;
 		dir->pos = 0;
 		return dir;
@@ -46,7 +58,7 @@ dir_open (struct inode *inode) {
  * Return true if successful, false on failure. */
 struct dir *
 dir_open_root (void) {
-	return dir_open (inode_open (ROOT_DIR_SECTOR));
+	return dir_open (inode_open (root_fs, root_fs->root_sector));
 }
 
 /* Opens and returns a new directory for the same inode as DIR.
@@ -71,6 +83,20 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+/* Sets the position dir_readdir() reads DIR from to POS, a value
+ * earlier returned by dir_tell(). */
+void
+dir_seek (struct dir *dir, off_t pos) {
+	ASSERT (pos >= 0);
+	dir->pos = pos;
+}
+
+/* Returns the position dir_readdir() reads DIR from next. */
+off_t
+dir_tell (const struct dir *dir) {
+	return dir->pos;
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
@@ -100,20 +126,43 @@ lookup (const struct dir *dir, const char *name,
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
- * a null pointer.  The caller must close *INODE. */
+ * a null pointer.  The caller must close *INODE.
+ * "." is DIR itself and ".." its parent.  If another file system
+ * is mounted over the file, *INODE is the root directory of that
+ * file system instead, and ".." of that root is the parent of the
+ * mount point.  A removed directory contains nothing. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
+	struct filesys *fs, *mounted;
 	struct dir_entry e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
+	fs = inode_get_fs (dir->inode);
+
+	if (inode_is_removed (dir->inode))
+		*inode = NULL;
+	else if (!strcmp (name, "."))
+		*inode = inode_reopen (dir->inode);
+	else if (!strcmp (name, "..") && fs->mount_point != NULL
+			&& inode_get_inumber (dir->inode) == fs->root_sector) {
+		struct dir *mount_dir = dir_open (inode_reopen (fs->mount_point));
+		if (mount_dir == NULL || !dir_lookup (mount_dir, "..", inode))
+			*inode = NULL;
+		dir_close (mount_dir);
+		return *inode != NULL;
+	} else if (lookup (dir, name, &e, NULL))
+		*inode = inode_open (fs, e.inode_sector);
 	else
 		*inode = NULL;
 
+	if (*inode != NULL && (mounted = inode_get_mounted (*inode)) != NULL) {
+		inode_close (*inode);
+		*inode = inode_open (mounted, mounted->root_sector);
+	}
+
 	return *inode != NULL;
 }
 
@@ -132,8 +181,10 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	/* Check NAME for validity. */
-	if (*name == '\0' || strlen (name) > NAME_MAX)
+	/* Check NAME for validity.  "." is never stored, and nothing
+	 * can be added to a directory that has been removed. */
+	if (*name == '\0' || strlen (name) > NAME_MAX || !strcmp (name, ".")
+			|| inode_is_removed (dir->inode))
 		return false;
 
 	/* Check that NAME is not in use. */
@@ -162,9 +213,23 @@ done:
 	return success;
 }
 
+/* Returns true if directory INODE has no entries but "..". */
+static bool
+is_empty (struct inode *inode) {
+	struct dir_entry e;
+	off_t ofs;
+
+	for (ofs = 0; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+			ofs += sizeof e)
+		if (e.in_use && strcmp (e.name, ".."))
+			return false;
+	return true;
+}
+
 /* Removes any entry for NAME in DIR.
- * Returns true if successful, false on failure,
- * which occurs only if there is no file with the given NAME. */
+ * Returns true if successful, false on failure, which occurs if
+ * there is no file with the given NAME or it is a mount point or
+ * a directory that is not empty. */
 bool
 dir_remove (struct dir *dir, const char *name) {
 	struct dir_entry e;
@@ -176,12 +241,15 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
-	if (!lookup (dir, name, &e, &ofs))
+	if (!strcmp (name, ".") || !strcmp (name, "..")
+			|| !lookup (dir, name, &e, &ofs))
 		goto done;
 
-	/* Open inode. */
-	inode = inode_open (e.inode_sector);
-	if (inode == NULL)
+	/* Open inode.  Mount points and directories that are not empty
+	 * cannot be removed. */
+	inode = inode_open (inode_get_fs (dir->inode), e.inode_sector);
+	if (inode == NULL || inode_get_mounted (inode) != NULL
+			|| (inode_is_dir (inode) && !is_empty (inode)))
 		goto done;
 
 	/* Erase directory entry. */
@@ -200,14 +268,14 @@ done:
 
 /* Reads the next directory entry in DIR and stores the name in
  * NAME.  Returns true if successful, false if the directory
- * contains no more entries. */
+ * contains no more entries.  ".." is skipped. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
 
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
-		if (e.in_use) {
+		if (e.in_use && strcmp (e.name, "..")) {
 			strlcpy (name, e.name, NAME_MAX + 1);
 			return true;
 		}
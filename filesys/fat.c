@@ -1,6 +1,9 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
+#include <round.h>
 #include "devices/disk.h"
 #include "filesys/filesys.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
 #include <stdio.h>
@@ -24,35 +27,49 @@ struct fat_fs {
 	disk_sector_t data_start;
 	cluster_t last_clst;
 	struct lock write_lock;
+	struct bitmap *used_clusters; /* Clusters whose FAT entry is nonzero. */
+	struct bitmap *dirty_sectors; /* FAT sectors changed since loaded. */
+	size_t dirty_cnt;             /* Sectors marked in DIRTY_SECTORS. */
+	struct bitmap *pending_clusters; /* Freed, but still marked used
+	                                    until the free commits. */
 };
 
-static struct fat_fs *fat_fs;
+/* Number of FAT entries held by one sector of the FAT. */
+#define ENTRIES_PER_SECTOR (DISK_SECTOR_SIZE / sizeof (cluster_t))
 
-void fat_boot_create (void);
-void fat_fs_init (void);
+void fat_boot_create (struct filesys *fs);
+void fat_fs_init (struct filesys *fs);
+static void fat_bitmaps_init (struct filesys *fs);
 
-void
-fat_init (void) {
-	fat_fs = calloc (1, sizeof (struct fat_fs));
+/* Reads the FAT boot sector of FS.  Returns true if the disk holds
+ * a FAT file system, false if it still has to be formatted. */
+bool
+fat_init (struct filesys *fs) {
+	struct fat_fs *fat_fs = calloc (1, sizeof (struct fat_fs));
 	if (fat_fs == NULL)
 		PANIC ("FAT init failed");
+	fs->fat = fat_fs;
 
 	// Read boot sector from the disk
 	unsigned int *bounce = malloc (DISK_SECTOR_SIZE);
 	if (bounce == NULL)
 		PANIC ("FAT init failed");
-	disk_read (filesys_disk, FAT_BOOT_SECTOR, bounce);
+	disk_read (fs->disk, FAT_BOOT_SECTOR, bounce);
 	memcpy (&fat_fs->bs, bounce, sizeof (fat_fs->bs));
 	free (bounce);
 
 	// Extract FAT info
-	if (fat_fs->bs.magic != FAT_MAGIC)
-		fat_boot_create ();
-	fat_fs_init ();
+	bool formatted = fat_fs->bs.magic == FAT_MAGIC;
+	if (!formatted)
+		fat_boot_create (fs);
+	fat_fs_init (fs);
+	return formatted;
 }
 
 void
-fat_open (void) {
+fat_open (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
@@ -65,85 +82,127 @@ fat_open (void) {
 	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
 		bytes_left = fat_size_in_bytes - bytes_read;
 		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
+			disk_read (fs->disk, fat_fs->bs.fat_start + i,
 			           buffer + bytes_read);
 			bytes_read += DISK_SECTOR_SIZE;
 		} else {
 			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
 			if (bounce == NULL)
 				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
+			disk_read (fs->disk, fat_fs->bs.fat_start + i, bounce);
 			memcpy (buffer + bytes_read, bounce, bytes_left);
 			bytes_read += bytes_left;
 			free (bounce);
 		}
 	}
+	fat_bitmaps_init (fs);
 }
 
 void
-fat_close (void) {
+fat_close (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
 	// Write FAT boot sector
 	uint8_t *bounce = calloc (1, DISK_SECTOR_SIZE);
 	if (bounce == NULL)
 		PANIC ("FAT close failed");
 	memcpy (bounce, &fat_fs->bs, sizeof (fat_fs->bs));
-	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
+	disk_write (fs->disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
+	fat_flush (fs);
+
+	free (fat_fs->fat);
+	bitmap_destroy (fat_fs->used_clusters);
+	bitmap_destroy (fat_fs->dirty_sectors);
+	bitmap_destroy (fat_fs->pending_clusters);
+	free (fat_fs);
+	fs->fat = NULL;
+}
+
+/* Writes the FAT sectors changed since the last flush.  The journal
+ * calls this before each commit, so that cluster allocations commit
+ * together with the inodes that use them.  Clusters freed since the
+ * last flush become available again: nothing can allocate them
+ * before the commit that follows is done. */
+void
+fat_flush (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
+	uint8_t *bounce;
+
+	if (fat_fs->dirty_sectors == NULL)
+		return;
+
+	lock_acquire (&fat_fs->write_lock);
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
+	size_t i = 0;
+	while ((i = bitmap_scan (fat_fs->pending_clusters, i, 1, true))
+	       != BITMAP_ERROR) {
+		bitmap_reset (fat_fs->used_clusters, i);
+		bitmap_reset (fat_fs->pending_clusters, i);
+	}
+	i = 0;
+	while ((i = bitmap_scan (fat_fs->dirty_sectors, i, 1, true))
+	       != BITMAP_ERROR) {
+		off_t bytes_wrote = i * DISK_SECTOR_SIZE;
+		off_t bytes_left = fat_size_in_bytes - bytes_wrote;
 		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
+			journal_write (fs, fat_fs->bs.fat_start + i, buffer + bytes_wrote);
 		} else {
 			bounce = calloc (1, DISK_SECTOR_SIZE);
 			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
+				PANIC ("FAT flush failed");
+			if (bytes_left > 0)
+				memcpy (bounce, buffer + bytes_wrote, bytes_left);
+			journal_write (fs, fat_fs->bs.fat_start + i, bounce);
 			free (bounce);
 		}
+		bitmap_reset (fat_fs->dirty_sectors, i);
+		fat_fs->dirty_cnt--;
 	}
+	lock_release (&fat_fs->write_lock);
 }
 
 void
-fat_create (void) {
+fat_create (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
 	// Create FAT boot
-	fat_boot_create ();
-	fat_fs_init ();
+	fat_boot_create (fs);
+	fat_fs_init (fs);
 
 	// Create FAT table
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_bitmaps_init (fs);
+
+	// The whole table is new, so all of it must reach the disk
+	bitmap_set_all (fat_fs->dirty_sectors, true);
+	fat_fs->dirty_cnt = fat_fs->bs.fat_sectors;
 
 	// Set up ROOT_DIR_CLST
-	fat_put (ROOT_DIR_CLUSTER, EOChain);
+	fat_put (fs, ROOT_DIR_CLUSTER, EOChain);
 
 	// Fill up ROOT_DIR_CLUSTER region with 0
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	disk_write (fs->disk, cluster_to_sector (fs, ROOT_DIR_CLUSTER), buf);
 	free (buf);
 }
 
 void
-fat_boot_create (void) {
+fat_boot_create (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
+	// Leave the end of the disk for the journal
+	unsigned int total_sectors = disk_size (fs->disk) - JOURNAL_SECTORS;
 	unsigned int fat_sectors =
-	    (disk_size (filesys_disk) - 1)
+	    (total_sectors - 1)
 	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * SECTORS_PER_CLUSTER + 1) + 1;
 	fat_fs->bs = (struct fat_boot){
 	    .magic = FAT_MAGIC,
 	    .sectors_per_cluster = SECTORS_PER_CLUSTER,
-	    .total_sectors = disk_size (filesys_disk),
+	    .total_sectors = total_sectors,
 	    .fat_start = 1,
 	    .fat_sectors = fat_sectors,
 	    .root_dir_cluster = ROOT_DIR_CLUSTER,
@@ -151,8 +210,84 @@ fat_boot_create (void) {
 }
 
 void
-fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+fat_fs_init (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
+	const unsigned int entries_per_fat =
+	    fat_fs->bs.fat_sectors * ENTRIES_PER_SECTOR;
+
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+
+	/* Entry 0 is reserved, so cluster N is at data sector N - 1. */
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+	                     / SECTORS_PER_CLUSTER + 1;
+	if (fat_fs->fat_length > entries_per_fat)
+		fat_fs->fat_length = entries_per_fat;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	lock_init (&fat_fs->write_lock);
+}
+
+/* Returns the number of FAT sectors the next fat_flush() would
+ * write.  Read without the lock: the journal only needs a count
+ * that is current at the start of each operation. */
+size_t
+fat_dirty_cnt (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
+	return fat_fs->dirty_cnt;
+}
+
+/* Builds the free-cluster bitmap from the loaded FAT, and empty
+ * sets of dirty FAT sectors and pending clusters. */
+static void
+fat_bitmaps_init (struct filesys *fs) {
+	struct fat_fs *fat_fs = fs->fat;
+	cluster_t clst;
+
+	if (fat_fs->used_clusters != NULL)
+		bitmap_destroy (fat_fs->used_clusters);
+	if (fat_fs->dirty_sectors != NULL)
+		bitmap_destroy (fat_fs->dirty_sectors);
+	if (fat_fs->pending_clusters != NULL)
+		bitmap_destroy (fat_fs->pending_clusters);
+	fat_fs->used_clusters = bitmap_create (fat_fs->fat_length);
+	fat_fs->dirty_sectors = bitmap_create (fat_fs->bs.fat_sectors);
+	fat_fs->pending_clusters = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->used_clusters == NULL || fat_fs->dirty_sectors == NULL
+	    || fat_fs->pending_clusters == NULL)
+		PANIC ("FAT bitmap creation failed");
+	fat_fs->dirty_cnt = 0;
+
+	bitmap_mark (fat_fs->used_clusters, 0);
+	for (clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->used_clusters, clst);
+}
+
+/* Sets FAT entry CLST to VAL, keeping the free-cluster bitmap and
+ * the dirty sectors in step.  write_lock must be held. */
+static void
+fat_set (struct fat_fs *fat_fs, cluster_t clst, cluster_t val) {
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->used_clusters, clst, val != 0);
+	if (!bitmap_test (fat_fs->dirty_sectors, clst / ENTRIES_PER_SECTOR)) {
+		bitmap_mark (fat_fs->dirty_sectors, clst / ENTRIES_PER_SECTOR);
+		fat_fs->dirty_cnt++;
+	}
+}
+
+/* Frees cluster CLST.  If DEFER, it stays marked used until
+ * fat_flush(), so that it is not reused before the free commits.
+ * write_lock must be held. */
+static void
+fat_free (struct filesys *fs, cluster_t clst, bool defer) {
+	struct fat_fs *fat_fs = fs->fat;
+
+	fat_set (fat_fs, clst, 0);
+	if (defer) {
+		bitmap_mark (fat_fs->used_clusters, clst);
+		bitmap_mark (fat_fs->pending_clusters, clst);
+	}
+	journal_revoke (fs, cluster_to_sector (fs, clst), SECTORS_PER_CLUSTER);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -163,31 +298,107 @@ fat_fs_init (void) {
  * If CLST is 0, start a new chain.
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
-fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+fat_create_chain (struct filesys *fs, cluster_t clst) {
+	struct fat_fs *fat_fs = fs->fat;
+	size_t new;
+
+	lock_acquire (&fat_fs->write_lock);
+	/* Keep the chain contiguous if the next cluster is free, else
+	 * next fit: search from just past the last allocation. */
+	if (clst != 0 && clst + 1 < fat_fs->fat_length
+	    && !bitmap_test (fat_fs->used_clusters, clst + 1))
+		new = clst + 1;
+	else
+		new = bitmap_scan (fat_fs->used_clusters, fat_fs->last_clst, 1, false);
+	if (new == BITMAP_ERROR)
+		new = bitmap_scan (fat_fs->used_clusters, 1, 1, false);
+	if (new == BITMAP_ERROR) {
+		lock_release (&fat_fs->write_lock);
+		return 0;
+	}
+
+	fat_set (fat_fs, new, EOChain);
+	if (clst != 0)
+		fat_set (fat_fs, clst, new);
+	fat_fs->last_clst = new;
+	lock_release (&fat_fs->write_lock);
+	return new;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
-fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+fat_remove_chain (struct filesys *fs, cluster_t clst, cluster_t pclst) {
+	struct fat_fs *fat_fs = fs->fat;
+	bool defer = journal_defer_free (fs);
+	lock_acquire (&fat_fs->write_lock);
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_fs->fat[clst];
+		fat_free (fs, clst, defer);
+		clst = next;
+	}
+	if (pclst != 0)
+		fat_set (fat_fs, pclst, EOChain);
+	lock_release (&fat_fs->write_lock);
+}
+
+/* Removes clusters from the front of the chain starting at CLST,
+ * which nothing else may point to, stopping before they span more
+ * than SECTOR_CNT sectors of the FAT, so that the caller can let the
+ * journal commit in between.
+ * Returns the first cluster left, or 0 if the whole chain is gone. */
+cluster_t
+fat_remove_chain_head (struct filesys *fs, cluster_t clst,
+                       size_t sector_cnt) {
+	struct fat_fs *fat_fs = fs->fat;
+	bool defer = journal_defer_free (fs);
+	size_t spanned = 0, prev = BITMAP_ERROR;
+	lock_acquire (&fat_fs->write_lock);
+	while (clst != 0 && clst != EOChain) {
+		size_t sector = clst / ENTRIES_PER_SECTOR;
+		if (sector != prev) {
+			if (spanned == sector_cnt)
+				break;
+			spanned++;
+			prev = sector;
+		}
+		cluster_t next = fat_fs->fat[clst];
+		fat_free (fs, clst, defer);
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
+	return clst == EOChain ? 0 : clst;
 }
 
 /* Update a value in the FAT table. */
 void
-fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+fat_put (struct filesys *fs, cluster_t clst, cluster_t val) {
+	struct fat_fs *fat_fs = fs->fat;
+	lock_acquire (&fat_fs->write_lock);
+	fat_set (fat_fs, clst, val);
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
-fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+fat_get (struct filesys *fs, cluster_t clst) {
+	struct fat_fs *fat_fs = fs->fat;
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
-cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+cluster_to_sector (struct filesys *fs, cluster_t clst) {
+	struct fat_fs *fat_fs = fs->fat;
+	ASSERT (clst > 0);
+	return fat_fs->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
+}
+
+/* Convert a sector number in the data region back to its cluster #. */
+cluster_t
+sector_to_cluster (struct filesys *fs, disk_sector_t sector) {
+	struct fat_fs *fat_fs = fs->fat;
+	ASSERT (sector >= fat_fs->data_start);
+	return (sector - fat_fs->data_start) / SECTORS_PER_CLUSTER + 1;
 }
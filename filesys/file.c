@@ -1,29 +1,44 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "devices/disk.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
 
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	int ref_cnt;                /* References from file_open() and
+	                               file_share(). */
 };
 
+/* Slab cache for `struct file'. */
+static struct kmem_cache *file_slab;
+
+/* Initializes the file module. */
+void
+file_init (void) {
+	file_slab = kmem_cache_create ("file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) {
-	struct file *file = calloc (1, sizeof *file);
+	struct file *file = inode != NULL ? kmem_cache_alloc (file_slab) : NULL;
 	if (inode != NULL && file != NULL) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ref_cnt = 1;
 		return file;
 	} else {
 		inode_close (inode);
-		free (file);
+		kmem_cache_free (file_slab, file);
 		return NULL;
 	}
 }
@@ -48,13 +63,28 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Adds a reference to FILE and returns it.  All references share
+ * one position, so reading, writing or seeking through one moves
+ * the others too.  Each reference is dropped with file_close(). */
+struct file *
+file_share (struct file *file) {
+	file->ref_cnt++;
+	return file;
+}
+
+/* Returns true if FILE has more than one reference. */
+bool
+file_is_shared (struct file *file) {
+	return file->ref_cnt > 1;
+}
+
+/* Drops a reference to FILE, and closes FILE if it was the last. */
 void
 file_close (struct file *file) {
-	if (file != NULL) {
+	if (file != NULL && --file->ref_cnt == 0) {
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
+		kmem_cache_free (file_slab, file);
 	}
 }
 
@@ -113,6 +143,50 @@ file_write_at (struct file *file, const void *buffer, off_t size,
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies up to SIZE bytes from IN, starting at offset *IN_OFS,
+ * into OUT, starting at offset *OUT_OFS, through a page-sized
+ * kernel buffer, so the data never passes through user memory.
+ * Advances *IN_OFS and *OUT_OFS by the number of bytes copied,
+ * which is returned and may be less than SIZE if the end of IN
+ * is reached or OUT cannot be written.
+ * The files' current positions are unaffected. */
+off_t
+file_copy_range (struct file *in, off_t *in_ofs, struct file *out,
+		off_t *out_ofs, off_t size) {
+	uint8_t *buffer = palloc_get_page (0);
+	off_t bytes_copied = 0;
+
+	if (buffer == NULL)
+		return 0;
+
+	while (size > 0) {
+		/* End each chunk on a sector boundary of IN, so that after
+		 * the first chunk inode_read_at() reads whole sectors
+		 * straight into BUFFER. */
+		off_t chunk_size = PGSIZE - *in_ofs % DISK_SECTOR_SIZE;
+		if (chunk_size > size)
+			chunk_size = size;
+
+		off_t bytes_read = inode_read_at (in->inode, buffer, chunk_size,
+				*in_ofs);
+		if (bytes_read == 0)
+			break;
+		off_t bytes_written = inode_write_at (out->inode, buffer,
+				bytes_read, *out_ofs);
+
+		/* Advance. */
+		*in_ofs += bytes_written;
+		*out_ofs += bytes_written;
+		bytes_copied += bytes_written;
+		size -= bytes_written;
+		if (bytes_written < chunk_size)
+			break;
+	}
+	palloc_free_page (buffer);
+
+	return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
@@ -136,6 +210,15 @@ file_allow_write (struct file *file) {
 	}
 }
 
+/* Reserves disk space for bytes OFFSET through OFFSET + LEN - 1
+ * of FILE without writing it or changing FILE's length.
+ * Returns true if successful, false otherwise. */
+bool
+file_allocate (struct file *file, off_t offset, off_t len) {
+	ASSERT (file != NULL);
+	return inode_allocate_range (file->inode, offset, len);
+}
+
 /* Returns the size of FILE in bytes. */
 off_t
 file_length (struct file *file) {
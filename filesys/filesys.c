@@ -6,51 +6,360 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 #include "devices/disk.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 
-/* The disk that contains the file system. */
-struct disk *filesys_disk;
+/* File system on hd0:1, holding the root directory. */
+struct filesys *root_fs;
 
-static void do_format (void);
+/* Mounted file systems, in mount order, root_fs first.
+ * Protected by mount_lock. */
+static struct list mounts;
+static struct lock mount_lock;
+
+/* Most symbolic links followed while resolving one path. */
+#define MAX_SYMLINKS 8
+
+/* How often the sync thread commits every journal, in timer ticks. */
+#define SYNC_TICKS (5 * TIMER_FREQ)
+
+static struct filesys *filesys_load (struct disk *, bool format);
+static void filesys_unload (struct filesys *);
+static void do_format (struct filesys *);
+static void sync_daemon (void *aux);
+static struct dir *resolve_parent (const char *path,
+		char name[NAME_MAX + 1]);
+static struct inode *resolve (const char *path);
+static struct dir *start_dir (void);
+static struct dir *walk_parent (struct dir *, const char *path,
+		char name[NAME_MAX + 1], int *links);
+static struct inode *walk (struct dir *, const char *path, int *links);
+static struct inode *follow (struct dir *, const char *name, int *links);
+static bool create_at (const char *path, enum inode_type type,
+		off_t initial_size, const char *target);
 
 /* Initializes the file system module.
  * If FORMAT is true, reformats the file system. */
 void
 filesys_init (bool format) {
-	filesys_disk = disk_get (0, 1);
-	if (filesys_disk == NULL)
+	struct disk *disk = disk_get (0, 1);
+	if (disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
 	inode_init ();
+	file_init ();
 
-#ifdef EFILESYS
-	fat_init ();
+	list_init (&mounts);
+	lock_init (&mount_lock);
+	root_fs = filesys_load (disk, format);
+	if (root_fs == NULL)
+		PANIC ("file system initialization failed");
+	list_push_back (&mounts, &root_fs->elem);
+
+	thread_create ("fssync", PRI_DEFAULT, sync_daemon, NULL);
+}
+
+/* Shuts down the file system module, writing any unwritten data
+ * to disk.  File systems are unmounted in the reverse of the order
+ * they were mounted, so that each mount point is closed before the
+ * file system that holds it. */
+void
+filesys_done (void) {
+	lock_acquire (&mount_lock);
+	while (!list_empty (&mounts)) {
+		struct filesys *fs = list_entry (list_pop_back (&mounts),
+				struct filesys, elem);
+		if (fs->mount_point != NULL) {
+			inode_set_mounted (fs->mount_point, NULL);
+			inode_close (fs->mount_point);
+		}
+		filesys_unload (fs);
+	}
+	lock_release (&mount_lock);
+}
+
+/* Mounts the file system on disk CHAN_NO:DEV_NO over the existing
+ * directory PATH, formatting the disk first if it does not hold
+ * one.  Returns 0 if successful, -1 if the disk does not exist or
+ * is already in use, or if PATH is not a directory or is already a
+ * root directory. */
+int
+filesys_mount (const char *path, int chan_no, int dev_no) {
+	struct disk *disk;
+	struct inode *inode = NULL;
+	struct filesys *fs = NULL;
+	struct list_elem *e;
+
+	/* CHAN_NO and DEV_NO come from the user, and disk_get() asserts
+	   on a bad DEV_NO.  It returns NULL for a channel number that is
+	   too large, but not for a negative one. */
+	if (chan_no < 0 || dev_no < 0 || dev_no > 1)
+		return -1;
+
+	/* hd0:0 holds the kernel. */
+	disk = disk_get (chan_no, dev_no);
+	if (disk == NULL || disk == disk_get (0, 0))
+		return -1;
+
+	lock_acquire (&mount_lock);
+	for (e = list_begin (&mounts); e != list_end (&mounts); e = list_next (e))
+		if (list_entry (e, struct filesys, elem)->disk == disk)
+			goto done;
+
+	inode = resolve (path);
+	if (inode == NULL || !inode_is_dir (inode)
+			|| inode_get_inumber (inode) == inode_get_fs (inode)->root_sector)
+		goto done;
+
+	fs = filesys_load (disk, false);
+	if (fs != NULL) {
+		/* The mount point stays open until unmounted. */
+		fs->mount_point = inode;
+		inode_set_mounted (inode, fs);
+		inode = NULL;
+		list_push_back (&mounts, &fs->elem);
+	}
+
+done:
+	inode_close (inode);
+	lock_release (&mount_lock);
+	return fs != NULL ? 0 : -1;
+}
+
+/* Unmounts the file system mounted at PATH, writing any unwritten
+ * data to its disk.  Returns 0 if successful, -1 if PATH is not a
+ * mount point or files in the file system are still open. */
+int
+filesys_umount (const char *path) {
+	struct inode *inode;
+	struct filesys *fs;
+	bool is_root;
+	int result = -1;
+
+	lock_acquire (&mount_lock);
+	inode = resolve (path);
+	if (inode != NULL) {
+		fs = inode_get_fs (inode);
+		is_root = inode_get_inumber (inode) == fs->root_sector;
+		inode_close (inode);
+
+		if (is_root && fs != root_fs && !inode_fs_busy (fs)) {
+			list_remove (&fs->elem);
+			inode_set_mounted (fs->mount_point, NULL);
+			inode_close (fs->mount_point);
+			filesys_unload (fs);
+			result = 0;
+		}
+	}
+	lock_release (&mount_lock);
+	return result;
+}
 
-	if (format)
-		do_format ();
+/* Reads the file system on DISK, formatting it first if FORMAT is
+ * true or the disk has never been formatted, and replays its
+ * journal.  Returns the new file system, or NULL if memory runs
+ * out. */
+static struct filesys *
+filesys_load (struct disk *disk, bool format) {
+	struct filesys *fs = calloc (1, sizeof *fs);
+	if (fs == NULL)
+		return NULL;
+	fs->disk = disk;
+	list_init (&fs->open_inodes);
 
-	fat_open ();
+#ifdef EFILESYS
+	if (!fat_init (fs) || format) {
+		do_format (fs);
+		fat_init (fs);
+	}
+	fs->root_sector = cluster_to_sector (fs, ROOT_DIR_CLUSTER);
+
+	/* Replay the journal before reading any metadata. */
+	journal_open (fs, fat_dirty_cnt, fat_flush);
+	fat_open (fs);
 #else
 	/* Original FS */
-	free_map_init ();
-
-	if (format)
-		do_format ();
+	fs->root_sector = ROOT_DIR_SECTOR;
+	free_map_init (fs);
+	if (format || !inode_is_valid (fs, FREE_MAP_SECTOR)) {
+		do_format (fs);
+		free_map_init (fs);
+	}
 
-	free_map_open ();
+	/* Replay the journal before reading any metadata. */
+	journal_open (fs, free_map_sector_cnt, free_map_flush);
+	free_map_open (fs);
 #endif
+	return fs;
 }
 
-/* Shuts down the file system module, writing any unwritten data
- * to disk. */
-void
-filesys_done (void) {
-	/* Original FS */
+/* Commits the journal of FS, writes back its free map or FAT and
+ * frees FS. */
+static void
+filesys_unload (struct filesys *fs) {
+	journal_close (fs);
 #ifdef EFILESYS
-	fat_close ();
+	fat_close (fs);
 #else
-	free_map_close ();
+	free_map_close (fs);
 #endif
+	free (fs);
+}
+
+/* Commits the journal of every mounted file system every
+ * SYNC_TICKS, so that metadata changes reach disk even when no one
+ * calls fsync. */
+static void
+sync_daemon (void *aux UNUSED) {
+	struct list_elem *e;
+
+	for (;;) {
+		timer_sleep (SYNC_TICKS);
+		lock_acquire (&mount_lock);
+		for (e = list_begin (&mounts); e != list_end (&mounts);
+				e = list_next (e))
+			journal_sync (list_entry (e, struct filesys, elem));
+		lock_release (&mount_lock);
+	}
+}
+
+/* Opens the directory that holds the last component of PATH and
+ * copies that component into NAME.  An absolute PATH is walked
+ * from the root, a relative one from the current directory, which
+ * stays open so that it need not be looked up again; both cross
+ * mount points and follow symbolic links on the way.  NAME is
+ * empty if PATH names the root.
+ * Returns a null pointer if PATH is empty, a directory on the way
+ * does not exist or a component is longer than NAME_MAX. */
+static struct dir *
+resolve_parent (const char *path, char name[NAME_MAX + 1]) {
+	int links = 0;
+
+	return walk_parent (start_dir (), path, name, &links);
+}
+
+/* Returns an inode for the file PATH names, following symbolic
+ * links, or a null pointer if there is none.  The caller must
+ * close it. */
+static struct inode *
+resolve (const char *path) {
+	int links = 0;
+
+	return walk (start_dir (), path, &links);
+}
+
+/* Opens the directory relative paths start from: the current
+ * directory of the running thread, or the root if it has none. */
+static struct dir *
+start_dir (void) {
+	struct dir *cwd = thread_current ()->cwd;
+
+	return cwd != NULL ? dir_reopen (cwd) : dir_open_root ();
+}
+
+/* Does the work of resolve_parent(), walking a relative PATH from
+ * DIR, which it closes.  *LINKS counts the symbolic links followed
+ * so far. */
+static struct dir *
+walk_parent (struct dir *dir, const char *path, char name[NAME_MAX + 1],
+		int *links) {
+	struct inode *inode;
+	size_t len;
+
+	if (*path == '\0') {
+		dir_close (dir);
+		return NULL;
+	}
+	if (*path == '/') {
+		dir_close (dir);
+		dir = dir_open_root ();
+	}
+
+	name[0] = '\0';
+	for (;;) {
+		if (dir == NULL)
+			return NULL;
+		while (*path == '/')
+			path++;
+		len = strcspn (path, "/");
+		if (len == 0)
+			break;
+		if (len > NAME_MAX) {
+			dir_close (dir);
+			return NULL;
+		}
+
+		/* NAME was not the last component, so step into it. */
+		if (name[0] != '\0') {
+			inode = follow (dir, name, links);
+			dir_close (dir);
+			if (inode == NULL || !inode_is_dir (inode)) {
+				inode_close (inode);
+				return NULL;
+			}
+			dir = dir_open (inode);
+			if (dir == NULL)
+				return NULL;
+		}
+		memcpy (name, path, len);
+		name[len] = '\0';
+		path += len;
+	}
+	return dir;
+}
+
+/* Does the work of resolve(), walking a relative PATH from DIR,
+ * which it closes.  *LINKS counts the symbolic links followed so
+ * far. */
+static struct inode *
+walk (struct dir *dir, const char *path, int *links) {
+	char name[NAME_MAX + 1];
+	struct inode *inode;
+
+	dir = walk_parent (dir, path, name, links);
+	if (dir == NULL)
+		return NULL;
+	if (name[0] == '\0')
+		inode = inode_reopen (dir_get_inode (dir));
+	else
+		inode = follow (dir, name, links);
+	dir_close (dir);
+	return inode;
+}
+
+/* Looks up NAME in DIR and returns its inode or, if it is a
+ * symbolic link, the inode of the file the link refers to.  A
+ * relative link target is resolved from DIR.
+ * Returns a null pointer if there is no such file, a link is
+ * dangling or more than MAX_SYMLINKS links have been followed. */
+static struct inode *
+follow (struct dir *dir, const char *name, int *links) {
+	struct inode *inode;
+	char *target = NULL;
+	off_t len;
+
+	if (!dir_lookup (dir, name, &inode))
+		return NULL;
+	if (!inode_is_symlink (inode))
+		return inode;
+
+	len = inode_length (inode);
+	if (++*links <= MAX_SYMLINKS)
+		target = malloc (len + 1);
+	if (target != NULL && inode_read_at (inode, target, len, 0) == len) {
+		target[len] = '\0';
+		inode_close (inode);
+		inode = walk (dir_reopen (dir), target, links);
+	} else {
+		inode_close (inode);
+		inode = NULL;
+	}
+	free (target);
+	return inode;
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -59,17 +368,48 @@ filesys_done (void) {
  * or if internal memory allocation fails. */
 bool
 filesys_create (const char *name, off_t initial_size) {
-	disk_sector_t inode_sector = 0;
-	struct dir *dir = dir_open_root ();
-	bool success = (dir != NULL
-			&& free_map_allocate (1, &inode_sector)
-			&& inode_create (inode_sector, initial_size)
-			&& dir_add (dir, name, inode_sector));
-	if (!success && inode_sector != 0)
-		free_map_release (inode_sector, 1);
-	dir_close (dir);
+	return create_at (name, INODE_FILE, initial_size, NULL);
+}
 
-	return success;
+/* Creates a directory named NAME.
+ * Returns true if successful, false otherwise.
+ * Fails if a file named NAME already exists, if a directory on
+ * the way to it does not, or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name) {
+	return create_at (name, INODE_DIR, 0, NULL);
+}
+
+/* Creates a symbolic link named LINKPATH that refers to TARGET,
+ * which need not exist.  Returns true if successful, false if
+ * LINKPATH already exists, TARGET is empty, or internal memory
+ * allocation fails. */
+bool
+filesys_symlink (const char *target, const char *linkpath) {
+	if (*target == '\0')
+		return false;
+	return create_at (linkpath, INODE_SYMLINK, 0, target);
+}
+
+/* Makes the directory NAME the current directory of the running
+ * thread.  Returns true if successful, false if NAME does not
+ * exist or is not a directory. */
+bool
+filesys_chdir (const char *name) {
+	struct thread *t = thread_current ();
+	struct inode *inode = resolve (name);
+	struct dir *dir;
+
+	if (inode == NULL || !inode_is_dir (inode)) {
+		inode_close (inode);
+		return false;
+	}
+	dir = dir_open (inode);
+	if (dir == NULL)
+		return false;
+	dir_close (t->cwd);
+	t->cwd = dir;
+	return true;
 }
 
 /* Opens the file with the given NAME.
@@ -79,14 +419,7 @@ filesys_create (const char *name, off_t initial_size) {
  * or if an internal memory allocation fails. */
 struct file *
 filesys_open (const char *name) {
-	struct dir *dir = dir_open_root ();
-	struct inode *inode = NULL;
-
-	if (dir != NULL)
-		dir_lookup (dir, name, &inode);
-	dir_close (dir);
-
-	return file_open (inode);
+	return file_open (resolve (name));
 }
 
 /* Deletes the file named NAME.
@@ -95,28 +428,103 @@ filesys_open (const char *name) {
  * or if an internal memory allocation fails. */
 bool
 filesys_remove (const char *name) {
-	struct dir *dir = dir_open_root ();
-	bool success = dir != NULL && dir_remove (dir, name);
+	char file_name[NAME_MAX + 1];
+	struct dir *dir = resolve_parent (name, file_name);
+	struct inode *inode;
+	struct filesys *fs;
+	bool success;
+
+	if (dir == NULL)
+		return false;
+	fs = inode_get_fs (dir_get_inode (dir));
+
+	/* Hold the file open across the removal, so that its data is
+	 * freed by the last close below, outside the operation, where a
+	 * long cluster chain can be freed over several commits. */
+	dir_lookup (dir, file_name, &inode);
+	journal_begin (fs);
+	success = dir_remove (dir, file_name);
+	journal_end (fs);
+	inode_close (inode);
 	dir_close (dir);
 
 	return success;
 }
 
-/* Formats the file system. */
+/* Creates a file, directory or symbolic link, according to TYPE,
+ * at PATH, with INITIAL_SIZE bytes of data if it is a file and
+ * referring to TARGET if it is a link. */
+static bool
+create_at (const char *path, enum inode_type type, off_t initial_size,
+		const char *target) {
+	char name[NAME_MAX + 1];
+	struct dir *dir = resolve_parent (path, name);
+	disk_sector_t inode_sector = 0;
+	disk_sector_t parent;
+	struct filesys *fs;
+	bool success;
+
+	if (dir == NULL)
+		return false;
+	fs = inode_get_fs (dir_get_inode (dir));
+	parent = inode_get_inumber (dir_get_inode (dir));
+
+	journal_begin (fs);
+#ifdef EFILESYS
+	cluster_t inode_clst = fat_create_chain (fs, 0);
+	if (inode_clst != 0)
+		inode_sector = cluster_to_sector (fs, inode_clst);
+	success = inode_clst != 0;
+#else
+	success = free_map_allocate (fs, 1, &inode_sector);
+#endif
+	if (success) {
+		switch (type) {
+			case INODE_DIR:
+				success = dir_create (fs, inode_sector, parent, 16);
+				break;
+			case INODE_SYMLINK:
+				success = inode_create_symlink (fs, inode_sector, target);
+				break;
+			default:
+				success = inode_create (fs, inode_sector, initial_size,
+						INODE_FILE);
+				break;
+		}
+	}
+	success = success && dir_add (dir, name, inode_sector);
+#ifdef EFILESYS
+	if (!success && inode_clst != 0)
+		fat_remove_chain (fs, inode_clst, 0);
+#else
+	if (!success && inode_sector != 0)
+		free_map_release (fs, inode_sector, 1);
+#endif
+	journal_end (fs);
+	dir_close (dir);
+
+	return success;
+}
+
+/* Formats the file system FS. */
 static void
-do_format (void) {
+do_format (struct filesys *fs) {
 	printf ("Formatting file system...");
 
 #ifdef EFILESYS
 	/* Create FAT and save it to the disk. */
-	fat_create ();
-	fat_close ();
+	fat_create (fs);
+	fs->root_sector = cluster_to_sector (fs, ROOT_DIR_CLUSTER);
+	if (!dir_create (fs, fs->root_sector, fs->root_sector, 16))
+		PANIC ("root directory creation failed");
+	fat_close (fs);
 #else
-	free_map_create ();
-	if (!dir_create (ROOT_DIR_SECTOR, 16))
+	free_map_create (fs);
+	if (!dir_create (fs, fs->root_sector, fs->root_sector, 16))
 		PANIC ("root directory creation failed");
-	free_map_close ();
+	free_map_close (fs);
 #endif
+	journal_format (fs);
 
 	printf ("done.\n");
 }
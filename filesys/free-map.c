@@ -1,77 +1,281 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
-static struct file *free_map_file;   /* Free map file. */
-static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+/* Number of free map bits held by one sector of the free map file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
 
-/* Initializes the free map. */
+/* Free map of one file system. */
+struct free_map {
+	struct file *file;          /* Free map file. */
+	struct bitmap *map;         /* Free map, one bit per disk sector. */
+
+	/* Sectors of the free map file whose bits changed since they
+	 * were last written, one bit per sector.  Allocation and
+	 * release only mark bits here; free_map_flush() writes the
+	 * marked sectors. */
+	struct bitmap *dirty;
+
+	/* Sectors released while journaling, one bit per disk sector.
+	 * They stay set in MAP, so nothing reuses them before the free
+	 * commits, until free_map_flush() clears them there. */
+	struct bitmap *pending;
+
+	/* Next-fit rover: where the next allocation without a goal
+	 * starts looking, just past the previous allocation. */
+	disk_sector_t rover;
+
+	struct lock lock;           /* Protects all of the above. */
+};
+
+static disk_sector_t scan_from (struct free_map *, disk_sector_t goal,
+		size_t cnt);
+static void mark_dirty (struct free_map *, disk_sector_t sector, size_t cnt);
+static void flush_locked (struct free_map *);
+
+/* Initializes the free map of FS. */
 void
-free_map_init (void) {
-	free_map = bitmap_create (disk_size (filesys_disk));
-	if (free_map == NULL)
+free_map_init (struct filesys *fs) {
+	struct free_map *fm = calloc (1, sizeof *fm);
+	if (fm == NULL)
+		PANIC ("free map creation failed");
+	fm->map = bitmap_create (disk_size (fs->disk));
+	if (fm->map == NULL)
 		PANIC ("bitmap creation failed--disk is too large");
-	bitmap_mark (free_map, FREE_MAP_SECTOR);
-	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	fm->dirty = bitmap_create (DIV_ROUND_UP (bitmap_file_size (fm->map),
+				DISK_SECTOR_SIZE));
+	if (fm->dirty == NULL)
+		PANIC ("free map dirty set creation failed");
+	fm->pending = bitmap_create (disk_size (fs->disk));
+	if (fm->pending == NULL)
+		PANIC ("free map pending set creation failed");
+	lock_init (&fm->lock);
+	bitmap_mark (fm->map, FREE_MAP_SECTOR);
+	bitmap_mark (fm->map, fs->root_sector);
+	bitmap_set_multiple (fm->map, bitmap_size (fm->map) - JOURNAL_SECTORS,
+			JOURNAL_SECTORS, true);
+	fs->free_map = fm;
+}
+
+/* Returns the number of sectors in the free map file of FS, the
+ * most that one free_map_flush() can write. */
+size_t
+free_map_sector_cnt (struct filesys *fs) {
+	return bitmap_size (fs->free_map->dirty);
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
- * the first into *SECTORP.
+/* Allocates CNT consecutive sectors from the free map of FS and
+ * stores the first into *SECTORP.  Searching starts at the
+ * next-fit rover, so consecutive allocations land next to each
+ * other.
  * Returns true if successful, false if all sectors were
- * available. */
+ * available.
+ * The change reaches disk on the next free_map_flush(). */
+bool
+free_map_allocate (struct filesys *fs, size_t cnt, disk_sector_t *sectorp) {
+	return free_map_allocate_near (fs, BITMAP_ERROR, cnt, sectorp);
+}
+
+/* Like free_map_allocate(), but searches first at GOAL, the
+ * sector the caller would most like to get, such as the one just
+ * past the file's inode or its last block.  If GOAL is
+ * BITMAP_ERROR, searching starts at the next-fit rover instead. */
 bool
-free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+free_map_allocate_near (struct filesys *fs, disk_sector_t goal, size_t cnt,
+		disk_sector_t *sectorp) {
+	struct free_map *fm = fs->free_map;
+	disk_sector_t sector;
+
+	lock_acquire (&fm->lock);
+	if (goal == BITMAP_ERROR || goal >= bitmap_size (fm->map))
+		goal = fm->rover;
+	sector = scan_from (fm, goal, cnt);
+	if (sector != BITMAP_ERROR) {
+		bitmap_set_multiple (fm->map, sector, cnt, true);
+		mark_dirty (fm, sector, cnt);
+		fm->rover = sector + cnt;
 	}
+	lock_release (&fm->lock);
+
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Allocates exactly the CNT sectors starting at SECTOR, such as
+ * the ones just past the end of a file, if they are all free.
+ * Returns true if successful, false otherwise. */
+bool
+free_map_allocate_at (struct filesys *fs, disk_sector_t sector, size_t cnt) {
+	struct free_map *fm = fs->free_map;
+	bool success;
+
+	lock_acquire (&fm->lock);
+	success = (sector <= bitmap_size (fm->map)
+			&& cnt <= bitmap_size (fm->map) - sector
+			&& bitmap_none (fm->map, sector, cnt));
+	if (success) {
+		bitmap_set_multiple (fm->map, sector, cnt, true);
+		mark_dirty (fm, sector, cnt);
+	}
+	lock_release (&fm->lock);
+	return success;
+}
+
+/* Makes CNT sectors starting at SECTOR available for use.
+ * The change reaches disk on the next free_map_flush().  On a
+ * journaled file system the sectors are not allocated again until
+ * then, since that flush is part of the commit that frees them. */
 void
-free_map_release (disk_sector_t sector, size_t cnt) {
-	ASSERT (bitmap_all (free_map, sector, cnt));
-	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+free_map_release (struct filesys *fs, disk_sector_t sector, size_t cnt) {
+	struct free_map *fm = fs->free_map;
+	bool defer = journal_defer_free (fs);
+
+	lock_acquire (&fm->lock);
+	ASSERT (bitmap_all (fm->map, sector, cnt));
+	if (defer) {
+		ASSERT (bitmap_none (fm->pending, sector, cnt));
+		bitmap_set_multiple (fm->pending, sector, cnt, true);
+	} else {
+		bitmap_set_multiple (fm->map, sector, cnt, false);
+		mark_dirty (fm, sector, cnt);
+	}
+	lock_release (&fm->lock);
+	journal_revoke (fs, sector, cnt);
 }
 
-/* Opens the free map file and reads it from disk. */
+/* Writes every dirty sector of the free map of FS to disk.  The
+ * journal calls this before each commit, so that allocations
+ * commit together with the inodes that use them. */
 void
-free_map_open (void) {
-	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-	if (free_map_file == NULL)
+free_map_flush (struct filesys *fs) {
+	struct free_map *fm = fs->free_map;
+
+	lock_acquire (&fm->lock);
+	flush_locked (fm);
+	lock_release (&fm->lock);
+}
+
+/* Opens the free map file of FS and reads it from disk. */
+void
+free_map_open (struct filesys *fs) {
+	struct free_map *fm = fs->free_map;
+
+	fm->file = file_open (inode_open (fs, FREE_MAP_SECTOR));
+	if (fm->file == NULL)
 		PANIC ("can't open free map");
-	if (!bitmap_read (free_map, free_map_file))
+	if (!bitmap_read (fm->map, fm->file))
 		PANIC ("can't read free map");
+	bitmap_set_all (fm->dirty, false);
+	inode_set_journaled (file_get_inode (fm->file));
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Writes the free map of FS to disk, closes the free map file and
+ * frees the free map. */
 void
-free_map_close (void) {
-	file_close (free_map_file);
+free_map_close (struct filesys *fs) {
+	struct free_map *fm = fs->free_map;
+
+	lock_acquire (&fm->lock);
+	flush_locked (fm);
+	file_close (fm->file);
+	fm->file = NULL;
+	lock_release (&fm->lock);
+
+	fs->free_map = NULL;
+	bitmap_destroy (fm->map);
+	bitmap_destroy (fm->dirty);
+	bitmap_destroy (fm->pending);
+	free (fm);
 }
 
-/* Creates a new free map file on disk and writes the free map to
- * it. */
+/* Creates a new free map file on the disk of FS and writes the
+ * free map to it. */
 void
-free_map_create (void) {
+free_map_create (struct filesys *fs) {
+	struct free_map *fm = fs->free_map;
+
 	/* Create inode. */
-	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+	if (!inode_create (fs, FREE_MAP_SECTOR, bitmap_file_size (fm->map),
+				INODE_FILE))
 		PANIC ("free map creation failed");
 
 	/* Write bitmap to file. */
-	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-	if (free_map_file == NULL)
+	fm->file = file_open (inode_open (fs, FREE_MAP_SECTOR));
+	if (fm->file == NULL)
 		PANIC ("can't open free map");
-	if (!bitmap_write (free_map, free_map_file))
+	lock_acquire (&fm->lock);
+	if (!bitmap_write (fm->map, fm->file))
 		PANIC ("can't write free map");
+	bitmap_set_all (fm->dirty, false);
+	lock_release (&fm->lock);
+}
+
+/* Returns the first run of CNT free sectors in FM at or after
+ * GOAL, wrapping around to the start of the disk, or BITMAP_ERROR
+ * if there is none.  FM's lock must be held. */
+static disk_sector_t
+scan_from (struct free_map *fm, disk_sector_t goal, size_t cnt) {
+	disk_sector_t sector = bitmap_scan (fm->map, goal, cnt, false);
+	if (sector == BITMAP_ERROR && goal > 0)
+		sector = bitmap_scan (fm->map, 0, cnt, false);
+	return sector;
+}
+
+/* Marks the free map file sectors holding the bits for CNT disk
+ * sectors starting at SECTOR as dirty.  FM's lock must be held. */
+static void
+mark_dirty (struct free_map *fm, disk_sector_t sector, size_t cnt) {
+	size_t first, last;
+
+	if (cnt == 0)
+		return;
+	first = sector / BITS_PER_SECTOR;
+	last = (sector + cnt - 1) / BITS_PER_SECTOR;
+	bitmap_set_multiple (fm->dirty, first, last - first + 1, true);
+}
+
+/* Frees the pending sectors of FM in its map, then writes each run
+ * of consecutive dirty sectors of FM with one write and clears
+ * them.  Sectors that fail to write stay dirty.
+ * FM's lock must be held. */
+static void
+flush_locked (struct free_map *fm) {
+	size_t start = 0;
+
+	while ((start = bitmap_scan (fm->pending, start, 1, true))
+			!= BITMAP_ERROR) {
+		size_t end = bitmap_scan (fm->pending, start, 1, false);
+		if (end == BITMAP_ERROR)
+			end = bitmap_size (fm->pending);
+
+		bitmap_set_multiple (fm->map, start, end - start, false);
+		bitmap_set_multiple (fm->pending, start, end - start, false);
+		mark_dirty (fm, start, end - start);
+		start = end;
+	}
+
+	if (fm->file == NULL)
+		return;
+	start = 0;
+
+	while ((start = bitmap_scan (fm->dirty, start, 1, true))
+			!= BITMAP_ERROR) {
+		size_t end = bitmap_scan (fm->dirty, start, 1, false);
+		if (end == BITMAP_ERROR)
+			end = bitmap_size (fm->dirty);
+
+		if (bitmap_write_range (fm->map, fm->file,
+					start * DISK_SECTOR_SIZE,
+					(end - start) * DISK_SECTOR_SIZE))
+			bitmap_set_multiple (fm->dirty, start, end - start, false);
+		start = end;
+	}
 }
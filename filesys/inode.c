@@ -5,18 +5,35 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Bytes of data an inode can hold in its own sector. */
+#define INLINE_MAX 488
+
+/* Most sectors a growing file allocates beyond what it needs. */
+#define PREALLOC_MAX 128
+
 /* On-disk inode.
  * Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
+	disk_sector_t start;                /* First data sector, or with
+	                                       EFILESYS, first data cluster. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	uint32_t sectors;                   /* Data sectors allocated, which
+	                                       may run past LENGTH, or 0 for
+	                                       just enough for LENGTH. */
+	uint32_t type;                      /* An enum inode_type. */
+	uint32_t is_inline;                 /* Nonzero: the LENGTH bytes of
+	                                       data are in INLINE_DATA and
+	                                       no sectors are allocated. */
+	uint8_t inline_data[INLINE_MAX];    /* Inline data. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -26,13 +43,36 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+/* Returns the number of data sectors allocated to DATA. */
+static size_t
+allocated_sectors (const struct inode_disk *data) {
+	if (data->is_inline)
+		return 0;
+
+	size_t sectors = bytes_to_sectors (data->length);
+#ifdef EFILESYS
+	sectors = ROUND_UP (sectors, SECTORS_PER_CLUSTER);
+#endif
+	return data->sectors > sectors ? data->sectors : sectors;
+}
+
 /* In-memory inode. */
 struct inode {
 	struct list_elem elem;              /* Element in inode list. */
+	struct filesys *fs;                 /* File system holding the inode. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	void *exec_cache;                   /* Parsed executable header, or NULL. */
+	bool journaled;                     /* Contents are metadata. */
+	struct filesys *mounted;            /* File system mounted here. */
+#ifdef EFILESYS
+	struct lock walk_lock;              /* Guards WALK_IDX and WALK_CLST. */
+	off_t walk_idx;                     /* Cluster index of WALK_CLST. */
+	cluster_t walk_clst;                /* Last cluster byte_to_sector()
+	                                       found, or 0. */
+#endif
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -40,6 +80,42 @@ struct inode {
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
+#ifdef EFILESYS
+/* The cluster chain is walked from the last cluster found rather
+ * than from the start whenever POS is at or past it, so sequential
+ * access costs one FAT lookup per cluster.  Not every reader holds
+ * file_lock (mmap page-ins do not), so the cached pair is read and
+ * updated under WALK_LOCK. */
+static disk_sector_t
+byte_to_sector (struct inode *inode, off_t pos) {
+	off_t idx, i;
+	cluster_t clst;
+
+	ASSERT (inode != NULL);
+	if (pos >= inode->data.length)
+		return -1;
+
+	idx = pos / (DISK_SECTOR_SIZE * SECTORS_PER_CLUSTER);
+	lock_acquire (&inode->walk_lock);
+	if (inode->walk_clst != 0 && inode->walk_idx <= idx) {
+		i = inode->walk_idx;
+		clst = inode->walk_clst;
+	} else {
+		i = 0;
+		clst = inode->data.start;
+	}
+	for (; i < idx; i++) {
+		clst = fat_get (inode->fs, clst);
+		ASSERT (clst != 0 && clst != EOChain);
+	}
+	inode->walk_idx = idx;
+	inode->walk_clst = clst;
+	lock_release (&inode->walk_lock);
+
+	return cluster_to_sector (inode->fs, clst)
+		+ pos / DISK_SECTOR_SIZE % SECTORS_PER_CLUSTER;
+}
+#else
 static disk_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
@@ -48,24 +124,274 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 	else
 		return -1;
 }
+#endif
+
+/* Reads SECTOR of INODE's data into BUFFER, through the journal
+ * if INODE holds metadata. */
+static void
+sector_read (const struct inode *inode, disk_sector_t sector, void *buffer) {
+	if (inode->journaled)
+		journal_read (inode->fs, sector, buffer);
+	else
+		disk_read (inode->fs->disk, sector, buffer);
+}
+
+/* Writes BUFFER to SECTOR of INODE's data, through the journal if
+ * INODE holds metadata. */
+static void
+sector_write (const struct inode *inode, disk_sector_t sector,
+		const void *buffer) {
+	if (inode->journaled)
+		journal_write (inode->fs, sector, buffer);
+	else
+		disk_write (inode->fs->disk, sector, buffer);
+}
+
+/* Makes sure at least SECTORS data sectors are allocated to
+ * INODE, without writing them, and writes the updated inode.
+ * The file grows in place when the sectors just past it are free;
+ * otherwise it moves to a new run.  Without EFILESYS, growth asks
+ * for as many sectors again as the file has, up to PREALLOC_MAX,
+ * so a file appended to while another grows right past its end
+ * moves only now and then instead of on almost every append.
+ * With EFILESYS, a long chain is added to in steps: whenever the
+ * journal fills up, the clusters added so far are recorded in the
+ * inode and the journal may commit before the next one.
+ * Returns true if successful, false if the disk is full, in which
+ * case INODE keeps any clusters recorded before that. */
+static bool
+inode_allocate (struct inode *inode, size_t sectors) {
+	struct filesys *fs = inode->fs;
+	struct inode_disk *data = &inode->data;
+	size_t have = allocated_sectors (data);
+
+	if (sectors <= have)
+		return true;
+
+#ifdef EFILESYS
+	cluster_t last = 0, first_new = 0, clst;
+	size_t i;
+
+	if (have > 0) {
+		/* Start from the walk cache, which only ever moves forward
+		 * along the chain. */
+		lock_acquire (&inode->walk_lock);
+		if (inode->walk_clst != 0) {
+			i = inode->walk_idx;
+			last = inode->walk_clst;
+		} else {
+			i = 0;
+			last = data->start;
+		}
+		lock_release (&inode->walk_lock);
+		for (; i + 1 < have / SECTORS_PER_CLUSTER; i++)
+			last = fat_get (fs, last);
+	}
+	for (clst = last; have < sectors; have += SECTORS_PER_CLUSTER) {
+		if (first_new != 0 && journal_full (fs)) {
+			if (data->start == 0)
+				data->start = first_new;
+			data->sectors = have;
+			journal_write (fs, inode->sector, data);
+			journal_restart (fs);
+			first_new = 0;
+			last = clst;
+		}
+		clst = fat_create_chain (fs, clst);
+		if (clst == 0) {
+			if (first_new != 0)
+				fat_remove_chain (fs, first_new, last);
+			return false;
+		}
+		if (first_new == 0)
+			first_new = clst;
+	}
+	if (data->start == 0)
+		data->start = first_new;
+	data->sectors = have;
+#else
+	size_t want = have + (have < PREALLOC_MAX ? have : PREALLOC_MAX);
+	if (want < sectors)
+		want = sectors;
+
+	if (have > 0 && free_map_allocate_at (fs, data->start + have,
+				want - have))
+		sectors = want;
+	else if (have == 0 || !free_map_allocate_at (fs, data->start + have,
+				sectors - have)) {
+		/* Move the written part of the file to a new run. */
+		size_t used = bytes_to_sectors (data->length);
+		disk_sector_t start;
+		uint8_t *bounce;
+		size_t i;
+
+		bounce = malloc (DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			return false;
+		if (free_map_allocate_near (fs, inode->sector + 1, want, &start))
+			sectors = want;
+		else if (!free_map_allocate_near (fs, inode->sector + 1, sectors,
+					&start)) {
+			free (bounce);
+			return false;
+		}
+		/* The new run is not referenced by anything on disk until
+		 * the inode is, so it is written directly. */
+		for (i = 0; i < used; i++) {
+			sector_read (inode, data->start + i, bounce);
+			disk_write (fs->disk, start + i, bounce);
+		}
+		free (bounce);
+		if (have > 0)
+			free_map_release (fs, data->start, have);
+		data->start = start;
+	}
+	data->sectors = sectors;
+#endif
+	journal_write (fs, inode->sector, data);
+	return true;
+}
+
+/* Makes sure INODE has room for LENGTH bytes of data and writes
+ * the updated inode.  Inline data moves out to data sectors once
+ * LENGTH no longer fits in the inode sector: first to a single
+ * sector, so the data is in place before the journal can commit
+ * part of a long allocation.
+ * Returns true if successful, false if memory or disk allocation
+ * fails, in which case INODE still holds the same data. */
+static bool
+inode_reserve (struct inode *inode, off_t length) {
+	struct inode_disk *data = &inode->data;
+	off_t old_length = data->length;
+	uint8_t *bounce;
+
+	if (!data->is_inline)
+		return inode_allocate (inode, bytes_to_sectors (length));
+	if (length <= INLINE_MAX)
+		return true;
+
+	bounce = calloc (1, DISK_SECTOR_SIZE);
+	if (bounce == NULL)
+		return false;
+	memcpy (bounce, data->inline_data, old_length);
+
+	/* With no length, inode_allocate() has nothing to copy. */
+	data->is_inline = false;
+	data->length = 0;
+	if (!inode_allocate (inode, 1)) {
+		data->is_inline = true;
+		data->length = old_length;
+		free (bounce);
+		return false;
+	}
+	data->length = old_length;
+	if (old_length > 0)
+		sector_write (inode, byte_to_sector (inode, 0), bounce);
+	journal_write (inode->fs, inode->sector, data);
+	free (bounce);
+	return inode_allocate (inode, bytes_to_sectors (length));
+}
+
+/* Frees the data sectors of INODE, which nothing may reach any
+ * more.  A long cluster chain is freed a few FAT sectors at a time,
+ * letting the journal commit in between; a crash part way through
+ * only leaks the clusters not freed yet. */
+static void
+release_data (struct inode *inode) {
+	struct inode_disk *data = &inode->data;
+#ifdef EFILESYS
+	cluster_t clst = data->start;
+
+	while (clst != 0) {
+		clst = fat_remove_chain_head (inode->fs, clst,
+				JOURNAL_OP_BLOCKS - 1);
+		if (clst != 0 && journal_full (inode->fs))
+			journal_restart (inode->fs);
+	}
+#else
+	free_map_release (inode->fs, data->start, allocated_sectors (data));
+#endif
+	data->start = 0;
+	data->sectors = 0;
+}
+
+/* Writes zeros to bytes FROM through TO - 1 of INODE, which must
+ * be allocated.  Used for the gap left when a write starts past
+ * the end of the file, since allocated sectors are not zeroed. */
+static void
+zero_range (struct inode *inode, off_t from, off_t to) {
+	static const uint8_t zeros[DISK_SECTOR_SIZE];
+	uint8_t *bounce = NULL;
+
+	if (inode->data.is_inline) {
+		memset (inode->data.inline_data + from, 0, to - from);
+		return;
+	}
+
+	while (from < to) {
+		disk_sector_t sector_idx = byte_to_sector (inode, from);
+		int sector_ofs = from % DISK_SECTOR_SIZE;
+		off_t chunk_size = DISK_SECTOR_SIZE - sector_ofs;
+		if (chunk_size > to - from)
+			chunk_size = to - from;
+
+		if (chunk_size == DISK_SECTOR_SIZE)
+			sector_write (inode, sector_idx, zeros);
+		else {
+			if (bounce == NULL) {
+				bounce = malloc (DISK_SECTOR_SIZE);
+				if (bounce == NULL)
+					break;
+			}
+			sector_read (inode, sector_idx, bounce);
+			memset (bounce + sector_ofs, 0, chunk_size);
+			sector_write (inode, sector_idx, bounce);
+		}
+		from += chunk_size;
+	}
+	free (bounce);
+}
+
+/* Gives the new, empty inode in SECTOR of FS LENGTH bytes of zeros
+ * in data sectors.  Returns true if successful, false if memory or
+ * disk allocation fails, in which case the inode is left empty. */
+static bool
+inode_extend_new (struct filesys *fs, disk_sector_t sector, off_t length) {
+	struct inode *inode = inode_open (fs, sector);
+	bool success;
+
+	if (inode == NULL)
+		return false;
+	success = inode_allocate (inode, bytes_to_sectors (length));
+	if (success) {
+		inode->data.length = length;
+		zero_range (inode, 0, length);
+	} else
+		release_data (inode);
+	journal_write (fs, sector, &inode->data);
+	inode_close (inode);
+	return success;
+}
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Slab cache for `struct inode'. */
+static struct kmem_cache *inode_slab;
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	inode_slab = kmem_cache_create ("inode", sizeof (struct inode), NULL);
 }
 
-/* Initializes an inode with LENGTH bytes of data and
- * writes the new inode to sector SECTOR on the file system
- * disk.
+/* Initializes an inode of the given TYPE with LENGTH bytes of
+ * data and writes the new inode to sector SECTOR on the disk of FS.
+ * Data that fits is kept in the inode sector itself, so small files
+ * and directories take no data sectors and cost one read to open
+ * and read.
  * Returns true if successful.
  * Returns false if memory or disk allocation fails. */
 bool
-inode_create (disk_sector_t sector, off_t length) {
+inode_create (struct filesys *fs, disk_sector_t sector, off_t length,
+		enum inode_type type) {
 	struct inode_disk *disk_inode = NULL;
 	bool success = false;
 
@@ -80,32 +406,58 @@ inode_create (disk_sector_t sector, off_t length) {
 		size_t sectors = bytes_to_sectors (length);
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		disk_inode->type = type;
+		if (length <= INLINE_MAX) {
+			disk_inode->is_inline = true;
+			sectors = 0;
+		}
+		/* Data sectors are added through the open inode, which
+		 * places them right after it when it can and, with
+		 * EFILESYS, allocates a long chain in steps the journal can
+		 * hold. */
+		if (sectors > 0)
+			disk_inode->length = 0;
+		journal_write (fs, sector, disk_inode);
+		success = sectors == 0 || inode_extend_new (fs, sector, length);
 		free (disk_inode);
 	}
 	return success;
 }
 
-/* Reads an inode from SECTOR
+/* Creates a symbolic link inode in SECTOR of FS that refers to
+ * TARGET.  A target short enough is kept inline, like any small
+ * file, so following the link reads no data sector.
+ * Returns true if successful, false if memory or disk allocation
+ * fails. */
+bool
+inode_create_symlink (struct filesys *fs, disk_sector_t sector,
+		const char *target) {
+	off_t len = strlen (target);
+	struct inode *inode;
+	bool success;
+
+	if (!inode_create (fs, sector, 0, INODE_SYMLINK))
+		return false;
+	inode = inode_open (fs, sector);
+	if (inode == NULL)
+		return false;
+	success = inode_write_at (inode, target, len, 0) == len;
+	inode_close (inode);
+	return success;
+}
+
+/* Reads an inode from SECTOR of FS
  * and returns a `struct inode' that contains it.
  * Returns a null pointer if memory allocation fails. */
 struct inode *
-inode_open (disk_sector_t sector) {
+inode_open (struct filesys *fs, disk_sector_t sector) {
 	struct list_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+	/* Check whether this inode is already open.  Each file system
+	 * keeps its own list, since sector numbers repeat across
+	 * disks. */
+	for (e = list_begin (&fs->open_inodes); e != list_end (&fs->open_inodes);
 			e = list_next (e)) {
 		inode = list_entry (e, struct inode, elem);
 		if (inode->sector == sector) {
@@ -115,17 +467,26 @@ inode_open (disk_sector_t sector) {
 	}
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = kmem_cache_alloc (inode_slab);
 	if (inode == NULL)
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	list_push_front (&fs->open_inodes, &inode->elem);
+	inode->fs = fs;
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	inode->exec_cache = NULL;
+	inode->journaled = false;
+	inode->mounted = NULL;
+#ifdef EFILESYS
+	lock_init (&inode->walk_lock);
+	inode->walk_idx = 0;
+	inode->walk_clst = 0;
+#endif
+	journal_read (fs, inode->sector, &inode->data);
 	return inode;
 }
 
@@ -137,6 +498,21 @@ inode_reopen (struct inode *inode) {
 	return inode;
 }
 
+/* Returns true if SECTOR of FS holds an inode, which tells
+ * whether a disk has been formatted. */
+bool
+inode_is_valid (struct filesys *fs, disk_sector_t sector) {
+	struct inode_disk *disk_inode = malloc (sizeof *disk_inode);
+	bool valid;
+
+	if (disk_inode == NULL)
+		return false;
+	disk_read (fs->disk, sector, disk_inode);
+	valid = disk_inode->magic == INODE_MAGIC;
+	free (disk_inode);
+	return valid;
+}
+
 /* Returns INODE's inode number. */
 disk_sector_t
 inode_get_inumber (const struct inode *inode) {
@@ -157,14 +533,22 @@ inode_close (struct inode *inode) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
 
-		/* Deallocate blocks if removed. */
+		/* Deallocate blocks if removed.  The inode goes first, so
+		 * that nothing reaches the data while it is freed. */
 		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			journal_begin (inode->fs);
+#ifdef EFILESYS
+			fat_remove_chain (inode->fs,
+					sector_to_cluster (inode->fs, inode->sector), 0);
+#else
+			free_map_release (inode->fs, inode->sector, 1);
+#endif
+			release_data (inode);
+			journal_end (inode->fs);
 		}
 
-		free (inode); 
+		free (inode->exec_cache);
+		kmem_cache_free (inode_slab, inode);
 	}
 }
 
@@ -185,6 +569,15 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	off_t bytes_read = 0;
 	uint8_t *bounce = NULL;
 
+	if (inode->data.is_inline) {
+		if (offset >= inode->data.length)
+			return 0;
+		if (size > inode->data.length - offset)
+			size = inode->data.length - offset;
+		memcpy (buffer, inode->data.inline_data + offset, size);
+		return size;
+	}
+
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -202,7 +595,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
 			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+			sector_read (inode, sector_idx, buffer + bytes_read);
 		} else {
 			/* Read sector into bounce buffer, then partially copy
 			 * into caller's buffer. */
@@ -211,7 +604,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 				if (bounce == NULL)
 					break;
 			}
-			disk_read (filesys_disk, sector_idx, bounce);
+			sector_read (inode, sector_idx, bounce);
 			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
 		}
 
@@ -227,9 +620,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs.
+ * A write past end of file extends the inode, using sectors
+ * reserved by inode_allocate_range() first. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
@@ -240,6 +633,42 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	if (inode->deny_write_cnt)
 		return 0;
 
+	/* The contents change, so a cached executable header is stale. */
+	if (size > 0 && inode->exec_cache != NULL) {
+		free (inode->exec_cache);
+		inode->exec_cache = NULL;
+	}
+
+	/* Growing writes the inode, and so does writing inline data,
+	 * so those are journaled operations.  Other writes are not: they
+	 * must not wait for a commit, since the free map is written back
+	 * from within one.  Inline metadata needs no operation of its
+	 * own, since it is only written within one or within a commit. */
+	bool grow = size > 0 && offset + size > inode->data.length;
+	bool op = grow || (size > 0 && inode->data.is_inline
+			&& !inode->journaled);
+	if (op)
+		journal_begin (inode->fs);
+	if (grow) {
+		off_t length = inode->data.length;
+
+		if (!inode_reserve (inode, offset + size)) {
+			journal_end (inode->fs);
+			return 0;
+		}
+		inode->data.length = offset + size;
+		if (offset > length)
+			zero_range (inode, length, offset);
+		journal_write (inode->fs, inode->sector, &inode->data);
+	}
+
+	if (inode->data.is_inline && size > 0) {
+		memcpy (inode->data.inline_data + offset, buffer, size);
+		journal_write (inode->fs, inode->sector, &inode->data);
+		bytes_written = size;
+		size = 0;
+	}
+
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -257,7 +686,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
 			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+			sector_write (inode, sector_idx, buffer + bytes_written);
 		} else {
 			/* We need a bounce buffer. */
 			if (bounce == NULL) {
@@ -270,11 +699,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 			   we're writing, then we need to read in the sector
 			   first.  Otherwise we start with a sector of all zeros. */
 			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
+				sector_read (inode, sector_idx, bounce);
 			else
 				memset (bounce, 0, DISK_SECTOR_SIZE);
 			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
+			sector_write (inode, sector_idx, bounce);
 		}
 
 		/* Advance. */
@@ -283,6 +712,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		bytes_written += chunk_size;
 	}
 	free (bounce);
+	if (op)
+		journal_end (inode->fs);
 
 	return bytes_written;
 }
@@ -311,3 +742,95 @@ off_t
 inode_length (const struct inode *inode) {
 	return inode->data.length;
 }
+
+/* Reserves data sectors for bytes OFFSET through OFFSET + LEN - 1
+ * of INODE without writing them or changing its length, so that
+ * later writes there need no allocation and stay contiguous when
+ * possible.  Returns true if successful, false if the disk is full
+ * or writes to INODE are denied. */
+bool
+inode_allocate_range (struct inode *inode, off_t offset, off_t len) {
+	bool success;
+
+	ASSERT (offset >= 0 && len >= 0);
+	if (inode->deny_write_cnt)
+		return false;
+
+	journal_begin (inode->fs);
+	success = inode_reserve (inode, offset + len);
+	journal_end (inode->fs);
+	return success;
+}
+
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode) {
+	return inode->data.type == INODE_DIR;
+}
+
+/* Returns true if INODE is a symbolic link. */
+bool
+inode_is_symlink (const struct inode *inode) {
+	return inode->data.type == INODE_SYMLINK;
+}
+
+/* Returns true if INODE has been removed but is still open. */
+bool
+inode_is_removed (const struct inode *inode) {
+	return inode->removed;
+}
+
+/* Returns the file system that holds INODE. */
+struct filesys *
+inode_get_fs (const struct inode *inode) {
+	return inode->fs;
+}
+
+/* Returns the file system mounted over INODE, or NULL. */
+struct filesys *
+inode_get_mounted (const struct inode *inode) {
+	return inode->mounted;
+}
+
+/* Mounts FS over INODE, or unmounts it if FS is NULL.  The caller
+ * keeps INODE open for as long as something is mounted there. */
+void
+inode_set_mounted (struct inode *inode, struct filesys *fs) {
+	inode->mounted = fs;
+}
+
+/* Returns true if any inode of FS other than the free map file is
+ * open, in which case FS cannot be unmounted. */
+bool
+inode_fs_busy (struct filesys *fs) {
+	struct list_elem *e;
+
+	for (e = list_begin (&fs->open_inodes); e != list_end (&fs->open_inodes);
+			e = list_next (e))
+		if (list_entry (e, struct inode, elem)->sector != FREE_MAP_SECTOR)
+			return true;
+	return false;
+}
+
+/* Marks INODE's contents as file system metadata, such as a
+ * directory, so that writes to it go through the journal. */
+void
+inode_set_journaled (struct inode *inode) {
+	inode->journaled = true;
+}
+
+/* Returns the executable header data cached on INODE by
+ * inode_set_exec_cache(), or NULL if there is none. */
+void *
+inode_get_exec_cache (const struct inode *inode) {
+	return inode->exec_cache;
+}
+
+/* Caches CACHE, a block from malloc(), on INODE, replacing any
+ * previous one.  The inode frees it with free() when the inode is
+ * written to or closed for the last time. */
+void
+inode_set_exec_cache (struct inode *inode, void *cache) {
+	free (inode->exec_cache);
+	inode->exec_cache = cache;
+}
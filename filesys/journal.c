@@ -0,0 +1,499 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Inode sectors, directory contents and the free map (or FAT) are
+   written with journal_write(), which only records the new block
+   contents in the running transaction.  Later writes to the same
+   block replace the recorded copy, and journal_read() returns it,
+   so the rest of the file system sees its own updates.
+
+   Each mounted file system has its own journal.  A transaction is
+   committed when it is close to full, when journal_sync() is
+   called (by fsync, by filesys.c's background thread every few
+   seconds, or at unmount and shutdown).  Committing writes
+   every block to the journal area at the end of the disk, then the
+   header sector naming their home sectors; once the header is on
+   disk the transaction survives a crash.  The blocks are then
+   written home and the header is cleared.  journal_open() replays
+   a committed header that was not cleared.
+
+   Every operation that writes metadata is bracketed by
+   journal_begin() and journal_end().  journal_begin() waits while
+   a commit is in progress or while the transaction may not have
+   room for another JOURNAL_OP_BLOCKS blocks, so a commit never
+   splits an operation.  All operations that end before a commit
+   starts go out together in that one commit.  The room counts the
+   blocks the flush function would write now, such as the dirty
+   sectors of the FAT, rather than all it could ever write.  An
+   operation that may dirty more, like growing a file by many
+   clusters, calls journal_full() as it goes and, once it has left
+   the file system consistent, journal_restart() to let the
+   transaction commit.
+
+   Sectors freed by an operation are not reused until the free has
+   committed, since file data written to them goes straight to disk
+   and would otherwise land while committed metadata still points
+   there.  journal_defer_free() arranges that. */
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* On-disk journal header.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_header {
+	uint32_t magic;                     /* JOURNAL_MAGIC. */
+	uint32_t seq;                       /* Sequence number of transaction. */
+	uint32_t cnt;                       /* Committed blocks, 0 if none. */
+	uint32_t checksum;                  /* Checksum of TARGETS and blocks. */
+	disk_sector_t targets[JOURNAL_BLOCKS]; /* Home sector of each block. */
+};
+
+/* A metadata block in the running transaction. */
+struct journal_block {
+	disk_sector_t sector;               /* Home sector. */
+	uint8_t *data;                      /* New contents. */
+};
+
+/* Journal of one file system. */
+struct journal {
+	struct filesys *fs;                 /* File system journaled. */
+	bool enabled;                       /* False: write through to disk. */
+	disk_sector_t start;                /* Sector of the header. */
+	size_t (*reserve) (struct filesys *); /* Blocks to keep for FLUSH. */
+	void (*flush) (struct filesys *);   /* Writes deferred metadata. */
+
+	/* Running transaction, protected by LOCK. */
+	struct lock lock;
+	struct condition cond;              /* Signaled on any change below. */
+	struct journal_block blocks[JOURNAL_BLOCKS];
+	size_t block_cnt;                   /* Blocks in use. */
+	int outstanding;                    /* Operations in progress. */
+	bool committing;                    /* True while a commit runs. */
+	bool free_pending;                  /* Freed sectors await a commit. */
+	uint32_t seq;                       /* Sequence number of transaction. */
+};
+
+static void recover (struct journal *);
+static bool has_room (struct journal *, int ops);
+static void wait_for_room (struct journal *);
+static void sync_locked (struct journal *);
+static void commit_blocks (struct journal *);
+static uint32_t checksum (const struct journal_header *,
+		uint8_t *const data[]);
+
+/* Returns the journal of FS if it is journaling, else NULL. */
+static struct journal *
+enabled_journal (struct filesys *fs) {
+	struct journal *j = fs->journal;
+	return j != NULL && j->enabled ? j : NULL;
+}
+
+/* Writes an empty journal to the newly formatted disk of FS. */
+void
+journal_format (struct filesys *fs) {
+	struct journal_header *h = calloc (1, sizeof *h);
+	if (h == NULL)
+		PANIC ("journal format failed");
+	h->magic = JOURNAL_MAGIC;
+	disk_write (fs->disk, disk_size (fs->disk) - JOURNAL_SECTORS, h);
+	free (h);
+}
+
+/* Replays a committed transaction that a crash left in the
+ * journal of FS, then starts journaling its metadata writes.
+ * RESERVE returns the number of blocks FLUSH would write if called
+ * now; the transaction keeps that many free for FLUSH, which
+ * journal_sync() calls before each commit to write metadata the
+ * file system itself defers.
+ * Disks formatted without a journal are left unjournaled. */
+void
+journal_open (struct filesys *fs, size_t (*reserve) (struct filesys *),
+		void (*flush) (struct filesys *)) {
+	struct journal *j;
+	size_t i;
+
+	ASSERT (sizeof (struct journal_header) == DISK_SECTOR_SIZE);
+
+	j = calloc (1, sizeof *j);
+	if (j == NULL)
+		PANIC ("journal creation failed");
+	j->fs = fs;
+	lock_init (&j->lock);
+	cond_init (&j->cond);
+	j->start = disk_size (fs->disk) - JOURNAL_SECTORS;
+	j->reserve = reserve;
+	j->flush = flush;
+
+	recover (j);
+
+	if (j->enabled && reserve (fs) + JOURNAL_OP_BLOCKS > JOURNAL_BLOCKS) {
+		printf ("journal: %zu sectors of metadata do not fit, "
+				"not journaling\n", reserve (fs));
+		j->enabled = false;
+	}
+	if (j->enabled)
+		for (i = 0; i < JOURNAL_BLOCKS; i++) {
+			j->blocks[i].data = malloc (DISK_SECTOR_SIZE);
+			if (j->blocks[i].data == NULL)
+				PANIC ("journal buffer allocation failed");
+		}
+
+	fs->journal = j;
+}
+
+/* Commits the running transaction of FS and stops journaling. */
+void
+journal_close (struct filesys *fs) {
+	struct journal *j = fs->journal;
+	size_t i;
+
+	journal_sync (fs);
+	fs->journal = NULL;
+	for (i = 0; i < JOURNAL_BLOCKS; i++)
+		free (j->blocks[i].data);
+	free (j);
+}
+
+/* Starts an operation on FS that may write up to
+ * JOURNAL_OP_BLOCKS metadata blocks.  Operations may nest, for
+ * example a file growing while a directory entry is added; the
+ * outermost one accounts for all of them. */
+void
+journal_begin (struct filesys *fs) {
+	struct journal *j = enabled_journal (fs);
+
+	if (j == NULL || thread_current ()->journal_depth++ > 0)
+		return;
+
+	lock_acquire (&j->lock);
+	wait_for_room (j);
+	j->outstanding++;
+	lock_release (&j->lock);
+}
+
+/* Ends an operation started with journal_begin().  Its writes are
+ * committed later, together with those of other operations. */
+void
+journal_end (struct filesys *fs) {
+	struct journal *j = enabled_journal (fs);
+
+	if (j == NULL || --thread_current ()->journal_depth > 0)
+		return;
+
+	lock_acquire (&j->lock);
+	ASSERT (j->outstanding > 0);
+	j->outstanding--;
+	cond_broadcast (&j->cond, &j->lock);
+	if (j->free_pending && j->outstanding == 0 && !j->committing)
+		sync_locked (j);
+	lock_release (&j->lock);
+}
+
+/* Returns true if the running transaction of FS no longer has
+ * room for JOURNAL_OP_BLOCKS more blocks from each operation in
+ * progress, so the calling operation should journal_restart()
+ * before it dirties more.  Always false for a nested operation,
+ * which cannot restart. */
+bool
+journal_full (struct filesys *fs) {
+	struct journal *j = enabled_journal (fs);
+	bool full;
+
+	if (j == NULL || thread_current ()->journal_depth != 1)
+		return false;
+
+	lock_acquire (&j->lock);
+	full = !has_room (j, j->outstanding);
+	lock_release (&j->lock);
+	return full;
+}
+
+/* Ends the calling operation on FS and starts it again, letting
+ * the running transaction commit in between if it is full.  The
+ * caller must have left the file system consistent, since a crash
+ * after the commit keeps what it did so far.  Does nothing for a
+ * nested operation. */
+void
+journal_restart (struct filesys *fs) {
+	struct journal *j = enabled_journal (fs);
+
+	if (j == NULL || thread_current ()->journal_depth != 1)
+		return;
+
+	lock_acquire (&j->lock);
+	ASSERT (j->outstanding > 0);
+	j->outstanding--;
+	cond_broadcast (&j->cond, &j->lock);
+	wait_for_room (j);
+	j->outstanding++;
+	lock_release (&j->lock);
+}
+
+/* Makes every metadata change on FS of operations that have ended
+ * durable.  If another thread is already committing, waits for
+ * its commit instead of starting one of our own. */
+void
+journal_sync (struct filesys *fs) {
+	struct journal *j = fs->journal;
+	uint32_t seq;
+
+	if (j == NULL)
+		return;
+	if (!j->enabled) {
+		if (j->flush != NULL)
+			j->flush (fs);
+		return;
+	}
+
+	lock_acquire (&j->lock);
+	seq = j->seq;
+	if (j->committing) {
+		while (j->seq == seq)
+			cond_wait (&j->cond, &j->lock);
+	} else
+		sync_locked (j);
+	lock_release (&j->lock);
+}
+
+/* Reads metadata SECTOR of FS into BUFFER, which must have room
+ * for DISK_SECTOR_SIZE bytes, seeing uncommitted journal_write()s. */
+void
+journal_read (struct filesys *fs, disk_sector_t sector, void *buffer) {
+	struct journal *j = enabled_journal (fs);
+	size_t i;
+
+	if (j != NULL) {
+		lock_acquire (&j->lock);
+		for (i = 0; i < j->block_cnt; i++)
+			if (j->blocks[i].sector == sector) {
+				memcpy (buffer, j->blocks[i].data, DISK_SECTOR_SIZE);
+				lock_release (&j->lock);
+				return;
+			}
+		lock_release (&j->lock);
+	}
+	disk_read (fs->disk, sector, buffer);
+}
+
+/* Writes DISK_SECTOR_SIZE bytes from BUFFER to metadata SECTOR of
+ * FS as part of the running transaction. */
+void
+journal_write (struct filesys *fs, disk_sector_t sector, const void *buffer) {
+	struct journal *j = enabled_journal (fs);
+	size_t i;
+
+	if (j == NULL) {
+		disk_write (fs->disk, sector, buffer);
+		return;
+	}
+
+	lock_acquire (&j->lock);
+	for (i = 0; i < j->block_cnt; i++)
+		if (j->blocks[i].sector == sector)
+			break;
+	if (i == j->block_cnt) {
+		ASSERT (j->block_cnt < JOURNAL_BLOCKS);
+		j->blocks[j->block_cnt++].sector = sector;
+	}
+	memcpy (j->blocks[i].data, buffer, DISK_SECTOR_SIZE);
+	lock_release (&j->lock);
+}
+
+/* Drops uncommitted writes to the CNT sectors of FS starting at
+ * SECTOR, which have just been freed.  Otherwise committing would
+ * write stale metadata over whatever the sectors are reused for.
+ * The free itself commits no earlier than the dropped writes would
+ * have, so nothing that could survive a crash loses them. */
+void
+journal_revoke (struct filesys *fs, disk_sector_t sector, size_t cnt) {
+	struct journal *j = enabled_journal (fs);
+	size_t i;
+
+	if (j == NULL || cnt == 0)
+		return;
+
+	lock_acquire (&j->lock);
+	for (i = 0; i < j->block_cnt; )
+		if (j->blocks[i].sector >= sector
+				&& j->blocks[i].sector - sector < cnt) {
+			/* Move the last block into the hole, keeping buffers. */
+			struct journal_block tmp = j->blocks[i];
+			j->blocks[i] = j->blocks[--j->block_cnt];
+			j->blocks[j->block_cnt] = tmp;
+		} else
+			i++;
+	lock_release (&j->lock);
+}
+
+/* Called when sectors of FS are freed.  Returns true if they must
+ * not be reused until the running transaction commits, in which
+ * case it commits as soon as its last operation ends, so they come
+ * back promptly.  Returns false if FS is not journaled and the
+ * sectors may be reused at once. */
+bool
+journal_defer_free (struct filesys *fs) {
+	struct journal *j = enabled_journal (fs);
+
+	if (j == NULL)
+		return false;
+
+	lock_acquire (&j->lock);
+	j->free_pending = true;
+	lock_release (&j->lock);
+	return true;
+}
+
+/* Reads the header of J and, if it names a committed transaction
+ * whose checksum matches, copies its blocks home.  Enables J if
+ * the disk has a journal. */
+static void
+recover (struct journal *j) {
+	struct disk *disk = j->fs->disk;
+	struct journal_header *h = malloc (sizeof *h);
+	uint8_t *data[JOURNAL_BLOCKS];
+	size_t i;
+
+	if (h == NULL)
+		PANIC ("journal recovery failed");
+	disk_read (disk, j->start, h);
+	if (h->magic != JOURNAL_MAGIC) {
+		free (h);
+		return;
+	}
+	j->enabled = true;
+	j->seq = h->seq + 1;
+
+	if (h->cnt > 0 && h->cnt <= JOURNAL_BLOCKS) {
+		for (i = 0; i < h->cnt; i++) {
+			data[i] = malloc (DISK_SECTOR_SIZE);
+			if (data[i] == NULL)
+				PANIC ("journal recovery failed");
+			disk_read (disk, j->start + 1 + i, data[i]);
+		}
+		if (checksum (h, data) == h->checksum) {
+			for (i = 0; i < h->cnt; i++)
+				disk_write (disk, h->targets[i], data[i]);
+			printf ("journal: replayed %"PRIu32" blocks\n", h->cnt);
+		}
+		for (i = 0; i < h->cnt; i++)
+			free (data[i]);
+	}
+
+	if (h->cnt != 0) {
+		h->cnt = 0;
+		disk_write (disk, j->start, h);
+	}
+	free (h);
+}
+
+/* Returns true if the running transaction of J has room for
+ * another JOURNAL_OP_BLOCKS blocks from each of OPS operations,
+ * besides the blocks its flush function would write.  J's lock must
+ * be held. */
+static bool
+has_room (struct journal *j, int ops) {
+	return j->block_cnt + j->reserve (j->fs) + ops * JOURNAL_OP_BLOCKS
+		<= JOURNAL_BLOCKS;
+}
+
+/* Waits until no commit is running and the running transaction of
+ * J has room for one more operation, committing it if it is full
+ * and no operation is in progress.  J's lock must be held. */
+static void
+wait_for_room (struct journal *j) {
+	for (;;) {
+		if (j->committing)
+			cond_wait (&j->cond, &j->lock);
+		else if (has_room (j, j->outstanding + 1))
+			break;
+		else if (j->outstanding == 0)
+			sync_locked (j);
+		else
+			cond_wait (&j->cond, &j->lock);
+	}
+}
+
+/* Commits the running transaction of J once no operation is in
+ * progress.  J's lock must be held and no commit running; it is
+ * released while J's flush function runs. */
+static void
+sync_locked (struct journal *j) {
+	ASSERT (!j->committing);
+
+	j->committing = true;
+	while (j->outstanding > 0)
+		cond_wait (&j->cond, &j->lock);
+
+	if (j->flush != NULL) {
+		lock_release (&j->lock);
+		j->flush (j->fs);
+		lock_acquire (&j->lock);
+	}
+	commit_blocks (j);
+
+	j->seq++;
+	j->free_pending = false;
+	j->committing = false;
+	cond_broadcast (&j->cond, &j->lock);
+}
+
+/* Writes the running transaction of J to the journal, commits it
+ * by writing the header, writes its blocks home and clears the
+ * header.  J's lock must be held. */
+static void
+commit_blocks (struct journal *j) {
+	struct disk *disk = j->fs->disk;
+	struct journal_header *h;
+	uint8_t *data[JOURNAL_BLOCKS];
+	size_t i;
+
+	if (j->block_cnt == 0)
+		return;
+
+	h = calloc (1, sizeof *h);
+	if (h == NULL)
+		PANIC ("journal commit failed");
+	h->magic = JOURNAL_MAGIC;
+	h->seq = j->seq;
+	h->cnt = j->block_cnt;
+	for (i = 0; i < j->block_cnt; i++) {
+		h->targets[i] = j->blocks[i].sector;
+		data[i] = j->blocks[i].data;
+		disk_write (disk, j->start + 1 + i, data[i]);
+	}
+	h->checksum = checksum (h, data);
+	disk_write (disk, j->start, h);
+
+	for (i = 0; i < j->block_cnt; i++)
+		disk_write (disk, j->blocks[i].sector, j->blocks[i].data);
+	h->cnt = 0;
+	disk_write (disk, j->start, h);
+	free (h);
+
+	j->block_cnt = 0;
+}
+
+/* Returns a checksum of the targets in H and the H->cnt blocks in
+ * DATA. */
+static uint32_t
+checksum (const struct journal_header *h, uint8_t *const data[]) {
+	uint32_t sum = h->seq;
+	size_t i, j;
+
+	for (i = 0; i < h->cnt; i++) {
+		const uint32_t *words = (const uint32_t *) data[i];
+		sum = (sum << 5 | sum >> 27) ^ h->targets[i];
+		for (j = 0; j < DISK_SECTOR_SIZE / sizeof *words; j++)
+			sum = (sum << 5 | sum >> 27) ^ words[j];
+	}
+	return sum;
+}
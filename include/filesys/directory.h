@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "devices/disk.h"
+#include "filesys/off_t.h"
 
 /* Maximum length of a file name component.
  * This is the traditional UNIX maximum length.
@@ -12,14 +13,18 @@
 #define NAME_MAX 14
 
 struct inode;
+struct filesys;
 
 /* Opening and closing directories. */
-bool dir_create (disk_sector_t sector, size_t entry_cnt);
+bool dir_create (struct filesys *, disk_sector_t sector, disk_sector_t parent,
+		size_t entry_cnt);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
 struct dir *dir_reopen (struct dir *);
 void dir_close (struct dir *);
 struct inode *dir_get_inode (struct dir *);
+void dir_seek (struct dir *, off_t);
+off_t dir_tell (const struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
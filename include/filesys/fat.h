@@ -18,21 +18,29 @@ typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 #define FAT_BOOT_SECTOR 0     /* FAT boot sector. */
 #define ROOT_DIR_CLUSTER 1    /* Cluster for the root directory */
 
-void fat_init (void);
-void fat_open (void);
-void fat_close (void);
-void fat_create (void);
-void fat_close (void);
+struct filesys;
+
+bool fat_init (struct filesys *);
+void fat_open (struct filesys *);
+void fat_close (struct filesys *);
+void fat_create (struct filesys *);
+void fat_flush (struct filesys *);
+size_t fat_dirty_cnt (struct filesys *);
 
 cluster_t fat_create_chain (
+    struct filesys *fs,
     cluster_t clst /* Cluster # to stretch, 0: Create a new chain */
 );
 void fat_remove_chain (
+    struct filesys *fs,
     cluster_t clst, /* Cluster # to be removed */
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
 );
-cluster_t fat_get (cluster_t clst);
-void fat_put (cluster_t clst, cluster_t val);
-disk_sector_t cluster_to_sector (cluster_t clst);
+cluster_t fat_remove_chain_head (struct filesys *fs, cluster_t clst,
+                                 size_t sector_cnt);
+cluster_t fat_get (struct filesys *fs, cluster_t clst);
+void fat_put (struct filesys *fs, cluster_t clst, cluster_t val);
+disk_sector_t cluster_to_sector (struct filesys *fs, cluster_t clst);
+cluster_t sector_to_cluster (struct filesys *fs, disk_sector_t sector);
 
 #endif /* filesys/fat.h */
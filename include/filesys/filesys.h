@@ -1,20 +1,46 @@
 #ifndef FILESYS_FILESYS_H
 #define FILESYS_FILESYS_H
 
+#include <list.h>
 #include <stdbool.h>
+#include "devices/disk.h"
 #include "filesys/off_t.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#else
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#endif
 
-/* Disk used for file system. */
-extern struct disk *filesys_disk;
+/* A file system on one disk.  The root file system is on hd0:1;
+ * filesys_mount() adds others, each with its own free map (or
+ * FAT), journal and table of open inodes. */
+struct filesys {
+	struct disk *disk;                  /* Disk holding the file system. */
+	disk_sector_t root_sector;          /* Root directory inode sector. */
+	struct free_map *free_map;          /* Free map, original FS. */
+	struct fat_fs *fat;                 /* FAT, with EFILESYS. */
+	struct journal *journal;            /* Metadata journal. */
+	struct list open_inodes;            /* Open inodes on this disk. */
+	struct inode *mount_point;          /* Inode mounted over, or NULL
+	                                       for the root file system. */
+	struct list_elem elem;              /* Element in mount list. */
+};
+
+/* File system on hd0:1, holding the root directory. */
+extern struct filesys *root_fs;
 
 void filesys_init (bool format);
 void filesys_done (void);
+int filesys_mount (const char *path, int chan_no, int dev_no);
+int filesys_umount (const char *path);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_mkdir (const char *name);
+bool filesys_chdir (const char *name);
+bool filesys_symlink (const char *target, const char *linkpath);
 
 #endif /* filesys/filesys.h */
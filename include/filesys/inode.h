@@ -6,11 +6,21 @@
 #include "devices/disk.h"
 
 struct bitmap;
+struct filesys;
+
+/* Kinds of inode. */
+enum inode_type {
+	INODE_FILE,                         /* Regular file. */
+	INODE_DIR,                          /* Directory. */
+	INODE_SYMLINK                       /* Symbolic link; data is target. */
+};
 
 void inode_init (void);
-bool inode_create (disk_sector_t, off_t);
-struct inode *inode_open (disk_sector_t);
+bool inode_create (struct filesys *, disk_sector_t, off_t, enum inode_type);
+bool inode_create_symlink (struct filesys *, disk_sector_t, const char *target);
+struct inode *inode_open (struct filesys *, disk_sector_t);
 struct inode *inode_reopen (struct inode *);
+bool inode_is_valid (struct filesys *, disk_sector_t);
 disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
@@ -19,5 +29,16 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+bool inode_allocate_range (struct inode *, off_t offset, off_t len);
+bool inode_is_dir (const struct inode *);
+bool inode_is_symlink (const struct inode *);
+bool inode_is_removed (const struct inode *);
+struct filesys *inode_get_fs (const struct inode *);
+struct filesys *inode_get_mounted (const struct inode *);
+void inode_set_mounted (struct inode *, struct filesys *);
+bool inode_fs_busy (struct filesys *);
+void inode_set_journaled (struct inode *);
+void *inode_get_exec_cache (const struct inode *);
+void inode_set_exec_cache (struct inode *, void *);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,39 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+/* Metadata blocks one transaction can hold. */
+#define JOURNAL_BLOCKS 124
+
+/* Sectors reserved at the end of the file system disk for the
+ * journal: a header followed by one sector per block. */
+#define JOURNAL_SECTORS (JOURNAL_BLOCKS + 1)
+
+/* Most metadata blocks a single file system operation may write
+ * between journal_begin() and journal_end(), or between calls to
+ * journal_restart(), counting the blocks it leaves for the journal's
+ * flush function to write. */
+#define JOURNAL_OP_BLOCKS 8
+
+struct filesys;
+
+void journal_format (struct filesys *);
+void journal_open (struct filesys *, size_t (*reserve) (struct filesys *),
+		void (*flush) (struct filesys *));
+void journal_close (struct filesys *);
+
+void journal_begin (struct filesys *);
+void journal_end (struct filesys *);
+bool journal_full (struct filesys *);
+void journal_restart (struct filesys *);
+void journal_sync (struct filesys *);
+
+void journal_read (struct filesys *, disk_sector_t, void *);
+void journal_write (struct filesys *, disk_sector_t, const void *);
+void journal_revoke (struct filesys *, disk_sector_t, size_t cnt);
+bool journal_defer_free (struct filesys *);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,16 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One buffer of a vectored I/O request, used by readv() and
+   writev().  Shared by the kernel and user programs. */
+struct iovec {
+	void *iov_base;             /* Start of the buffer. */
+	size_t iov_len;             /* Number of bytes in the buffer. */
+};
+
+/* Maximum number of buffers in a single readv() or writev(). */
+#define IOV_MAX 1024
+
+#endif /* lib/iovec.h */
@@ -36,6 +36,19 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Positioned and vectored I/O. */
+	SYS_PREAD,                  /* Read from a file at a given offset. */
+	SYS_PWRITE,                 /* Write to a file at a given offset. */
+	SYS_READV,                  /* Read from a file into several buffers. */
+	SYS_WRITEV,                 /* Write several buffers to a file. */
+	SYS_COPY_FILE_RANGE,        /* Copy data between files in the kernel. */
+	SYS_URING_SETUP,            /* Set up submission/completion rings. */
+	SYS_URING_ENTER,            /* Submit to and wait on the rings. */
+	SYS_SPAWN,                  /* Start a program in a new process. */
+	SYS_VFORK,                  /* Clone sharing the address space. */
+	SYS_FSYNC,                  /* Commit a file's metadata to disk. */
+	SYS_FALLOCATE,              /* Reserve disk space for a file. */
 };
 
 #endif /* lib/syscall-nr.h */
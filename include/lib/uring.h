@@ -0,0 +1,76 @@
+#ifndef __LIB_URING_H
+#define __LIB_URING_H
+
+#include <stdint.h>
+
+/* Shared submission and completion rings for batched file I/O.
+   Shared by the kernel and user programs.
+
+   uring_setup() maps a struct uring, followed by its submission
+   queue entries (SQEs) and completion queue entries (CQEs), at
+   URING_ADDR, right after the vDSO pages.  The user fills SQEs,
+   advances SQ_TAIL and calls uring_enter(); the kernel consumes
+   them by advancing SQ_HEAD, performs reads and writes on a
+   kernel worker thread, and posts one CQE per SQE by advancing
+   CQ_TAIL.  The user consumes CQEs by advancing CQ_HEAD.
+   Completions are not necessarily in submission order. */
+#define URING_ADDR ((struct uring *) 0x47482000)
+
+/* Maximum number of submission queue entries. */
+#define URING_MAX_ENTRIES 256
+
+/* Operations. */
+enum uring_op {
+	URING_OP_NOP,               /* Do nothing. */
+	URING_OP_READ,              /* pread (FD, ADDR, LEN, OFF). */
+	URING_OP_WRITE,             /* pwrite (FD, ADDR, LEN, OFF). */
+	URING_OP_OPEN,              /* open (ADDR). */
+	URING_OP_CLOSE,             /* close (FD). */
+};
+
+/* Submission queue entry. */
+struct uring_sqe {
+	uint8_t opcode;             /* One of enum uring_op. */
+	int32_t fd;                 /* File descriptor. */
+	uint64_t addr;              /* Buffer, or file name for open. */
+	uint32_t len;               /* Buffer length in bytes. */
+	int32_t off;                /* File offset. */
+	uint64_t user_data;         /* Passed back in the completion. */
+};
+
+/* Completion queue entry. */
+struct uring_cqe {
+	uint64_t user_data;         /* From the submission. */
+	int32_t res;                /* Syscall-style result, -1 on error. */
+};
+
+/* Ring header, at URING_ADDR.  Head and tail are free-running
+   counters; index an array with (counter & (entries - 1)).  The
+   kernel only reports SQ_ENTRIES and CQ_ENTRIES here and ignores
+   any later change to them. */
+struct uring {
+	volatile uint32_t sq_head;  /* Next SQE the kernel consumes. */
+	volatile uint32_t sq_tail;  /* Next SQE the user fills. */
+	volatile uint32_t cq_head;  /* Next CQE the user consumes. */
+	volatile uint32_t cq_tail;  /* Next CQE the kernel fills. */
+	uint32_t sq_entries;        /* Number of SQEs, a power of 2. */
+	uint32_t cq_entries;        /* Number of CQEs, twice SQ_ENTRIES. */
+};
+
+/* Size of the ring header, keeping the arrays 64-byte aligned. */
+#define URING_HDR_SIZE 64
+
+/* SQE and CQE arrays of ring R, which has SQ_ENTRIES submission
+   entries.  The kernel passes its own copy of SQ_ENTRIES rather
+   than trusting the header, which the user can write. */
+#define URING_SQES(R) \
+	((struct uring_sqe *) ((uint8_t *) (R) + URING_HDR_SIZE))
+#define URING_CQES(R, SQ_ENTRIES) \
+	((struct uring_cqe *) (URING_SQES (R) + (SQ_ENTRIES)))
+
+/* Bytes needed for a ring with SQ_ENTRIES submission entries. */
+#define URING_SIZE(SQ_ENTRIES) \
+	(URING_HDR_SIZE + (SQ_ENTRIES) * sizeof (struct uring_sqe) \
+	 + 2 * (SQ_ENTRIES) * sizeof (struct uring_cqe))
+
+#endif /* lib/uring.h */
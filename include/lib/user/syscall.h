@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <iovec.h>
+#include <uring.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -24,6 +27,8 @@ typedef int off_t;
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t fork (const char *thread_name);
+pid_t spawn (const char *file, char *const argv[]);
+pid_t vfork (void);
 int exec (const char *file);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
@@ -35,9 +40,23 @@ int write (int fd, const void *buffer, unsigned length);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+int fsync (int fd);
+int fallocate (int fd, off_t offset, off_t len);
 
 int dup2(int oldfd, int newfd);
 
+/* Positioned and vectored I/O. */
+int pread (int fd, void *buffer, unsigned length, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned length, off_t offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+		unsigned length);
+
+/* Batched I/O through shared rings; see <uring.h>. */
+struct uring *uring_setup (unsigned entries);
+int uring_enter (unsigned to_submit, unsigned min_complete);
+
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
@@ -50,6 +69,12 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Read from the kernel's vDSO pages, without a system call. */
+int64_t get_ticks (void);
+uint64_t get_tsc_per_tick (void);
+uint64_t get_time_ns (void);
+pid_t getpid (void);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
@@ -0,0 +1,34 @@
+#ifndef __LIB_VDSO_H
+#define __LIB_VDSO_H
+
+#include <stdint.h>
+
+/* Read-only pages that the kernel maps into every user process,
+   so that user code can read the clock and its own pid without
+   a system call.  Shared by the kernel and user programs.
+
+   VDSO_DATA is the same physical page in every process and is
+   updated by the timer interrupt.  VDSO_PROC is private to each
+   process.  Both sit just above USER_STACK. */
+#define VDSO_DATA ((const struct vdso_data *) 0x47480000)
+#define VDSO_PROC ((const struct vdso_proc *) 0x47481000)
+
+/* System-wide data, at VDSO_DATA.
+
+   The kernel makes SEQ odd before it updates the other members
+   and even again afterward, so a reader that sees SEQ odd, or
+   changed across its reads, must retry. */
+struct vdso_data {
+	volatile uint64_t seq;          /* Update sequence number. */
+	volatile int64_t ticks;         /* Timer ticks since boot. */
+	volatile uint64_t tick_tsc;     /* TSC at the last timer tick. */
+	volatile uint64_t tsc_per_tick; /* TSC cycles per tick, 0 if unknown. */
+	int32_t timer_freq;             /* Timer ticks per second. */
+};
+
+/* Per-process data, at VDSO_PROC. */
+struct vdso_proc {
+	int32_t pid;                    /* Process identifier. */
+};
+
+#endif /* lib/vdso.h */
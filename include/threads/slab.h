@@ -0,0 +1,18 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <debug.h>
+#include <stddef.h>
+
+/* Object cache.  Opaque outside slab.c. */
+struct kmem_cache;
+
+/* Constructor, run once on each object when its slab is created. */
+typedef void kmem_ctor (void *obj);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		kmem_ctor *ctor);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+
+#endif /* threads/slab.h */
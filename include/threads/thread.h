@@ -32,7 +32,8 @@ typedef int tid_t;
 #define ORI_PRI_DEFAULT -1              /* priority가 될 수 없는 값. ori_priority의 초기값으로 사용됨 */
 #define PRE_DEFAULT -99999
 
-#define FDLIST_LEN 20
+#define FD_MIN 3                        /* Lowest fd handed out by open(). */
+#define FD_MAX 8192                     /* Most fds a process may hold. */
 
 /* A kernel thread or user process.
  *
@@ -118,12 +119,17 @@ struct thread {
     int exit_status;                    /* PROJECT 2 - System Calls */
     struct thread *parent_process;      /* PROJECT 2 - System Calls */
     struct list child_list;             /* PROJECT 2 - System Calls */
-    struct file *fd_table[FDLIST_LEN];   /* PROJECT 2 - System Calls */
+    struct file **fd_table;             /* PROJECT 2 - System Calls */
+    struct bitmap *fd_map;              /* PROJECT 2 - System Calls */
+    int fd_cap;                         /* PROJECT 2 - System Calls */
     struct file *my_exec_file;          /* PROJECT 2 - System Calls */
     struct child_list_elem *my_info;    /* PROJECT 2 - System Calls */
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+	struct uring_ctx *uring;            /* Submission/completion rings, or NULL. */
+	struct thread *vfork_parent;        /* Parent whose address space we borrow. */
+	struct semaphore *vfork_sema;       /* Upped to wake VFORK_PARENT. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
@@ -131,6 +137,13 @@ struct thread {
     uint64_t rsp;
     uint64_t stack_btm; 
 #endif
+#ifdef FILESYS
+	/* Owned by filesys/journal.c. */
+	int journal_depth;                  /* Nesting of journal_begin(). */
+
+	/* Owned by filesys/filesys.c. */
+	struct dir *cwd;                    /* Current directory, NULL: root. */
+#endif
 
 	/* Owned by thread.c. */
 	struct intr_frame tf;               /* Information for switching */
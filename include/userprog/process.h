@@ -16,6 +16,8 @@ struct aux_data {
 bool lazy_load_segment (struct page *page, struct aux_data *aux) ;
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
+tid_t process_spawn (char *cmd_line);
+tid_t process_vfork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
 int process_wait (tid_t);
 void process_exit (void);
@@ -10,7 +10,7 @@ void syscall_init (void);
 struct lock file_lock;
 
 /* PROJECT 2: SYSTEM CALLS */
-#define SYSCALL_CNT 25
+#define SYSCALL_CNT 36
 
 /* PROJECT 2: SYSTEM CALLS */
 struct system_call {
@@ -44,7 +44,28 @@ void symlink_handler(struct intr_frame *f);
 void dup2_handler(struct intr_frame *f);
 void mount_handler(struct intr_frame *f);
 void umount_handler(struct intr_frame *f);
+void pread_handler(struct intr_frame *f);
+void pwrite_handler(struct intr_frame *f);
+void readv_handler(struct intr_frame *f);
+void writev_handler(struct intr_frame *f);
+void copy_file_range_handler(struct intr_frame *f);
+void uring_setup_handler(struct intr_frame *f);
+void uring_enter_handler(struct intr_frame *f);
+void spawn_handler(struct intr_frame *f);
+void vfork_handler(struct intr_frame *f);
+void fsync_handler(struct intr_frame *f);
+void fallocate_handler(struct intr_frame *f);
 
 void kern_exit(struct intr_frame *f, int status);
 
+/* PROJECT 2: FILE DESCRIPTOR TABLE */
+struct thread;
+struct file;
+int fd_table_insert(struct file *_file);
+struct file *fd_table_get_file(int fd);
+void fd_table_remove(int fd);
+bool fd_table_install(struct thread *t, int fd, struct file *_file);
+bool fd_table_duplicate(struct thread *parent, struct thread *child);
+void fd_table_destroy(struct thread *t);
+
 #endif /* userprog/syscall.h */
@@ -0,0 +1,13 @@
+#ifndef USERPROG_URING_H
+#define USERPROG_URING_H
+
+#include <stdbool.h>
+
+struct thread;
+
+void *uring_setup (unsigned entries);
+int uring_enter (unsigned to_submit, unsigned min_complete);
+void uring_quiesce (struct thread *);
+void uring_destroy (struct thread *);
+
+#endif /* userprog/uring.h */
@@ -0,0 +1,13 @@
+#ifndef USERPROG_VDSO_H
+#define USERPROG_VDSO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void vdso_init (void);
+void vdso_tick (int64_t ticks);
+bool vdso_map (uint64_t *pml4, int pid);
+void vdso_unmap (uint64_t *pml4);
+void vdso_set_pid (uint64_t *pml4, int pid);
+
+#endif /* userprog/vdso.h */
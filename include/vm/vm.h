@@ -2,9 +2,9 @@
 #define VM_VM_H
 #include <stdbool.h>
 #include "threads/palloc.h"
-#include "hash.h"
 #include "filesys/file.h"
 #include "threads/synch.h"
+#include "threads/slab.h"
 
 
 enum vm_type {
@@ -51,7 +51,6 @@ struct page {
 
 	/* Your implementation */
 	bool writable ;
-	struct hash_elem hash_elem; 
 	struct list_elem mmap_elem; 
 	enum vm_type full_type ; //vm_type with markers
 
@@ -73,6 +72,8 @@ struct page {
 struct frame {
 	void *kva;
 	struct page *page;
+	int pinned;            /* Pins by kernel I/O; never evict
+	                          while nonzero. */
 };
 
 /* The function table for page operations.
@@ -91,20 +92,45 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* One slot of the SPT hash table. The key (VA) is kept next to
+ * the page pointer so that probing never touches struct page. */
+struct spt_slot {
+	void *va;              /* Page-aligned user address, NULL if empty. */
+	struct page *page;
+};
+
+/* Open-addressing hash table from user page to struct page.
+ * Collisions are resolved by Robin Hood linear probing, so a
+ * lookup scans a short run of adjacent slots and stops as soon as
+ * it passes where the key would have been placed. */
+struct spt_hash {
+	struct spt_slot *slots;  /* CAPACITY slots, or NULL. */
+	size_t capacity;         /* Number of slots, 0 or a power of 2. */
+	size_t cnt;              /* Number of pages in the table. */
+};
+
 /* Representation of current process's memory space.
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-	struct hash hash_spt ;
+	struct spt_hash hash_spt ;
 	struct list mmap_list ;
 	struct lock spt_lock;
 };
 
+/* Slab caches for struct page, struct frame and struct aux_data,
+ * created by vm_init (). */
+extern struct kmem_cache *page_slab;
+extern struct kmem_cache *frame_slab;
+extern struct kmem_cache *aux_slab;
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
 		struct supplemental_page_table *src);
 void supplemental_page_table_kill (struct supplemental_page_table *spt);
+void supplemental_page_table_move (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
 struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
@@ -121,5 +147,7 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
+void vm_pin_range (const void *uaddr, size_t size);
+void vm_unpin_range (const void *uaddr, size_t size);
 
 #endif  /* VM_VM_H */
@@ -62,6 +62,54 @@ last_mask (const struct bitmap *b) {
 	int last_bits = b->bit_cnt % ELEM_BITS;
 	return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns a mask of the bits of element ELEM_IDX that fall in
+   the bit range [START, END). */
+static inline elem_type
+range_mask (size_t elem_idx, size_t start, size_t end) {
+	size_t first = elem_idx * ELEM_BITS;
+	elem_type mask = (elem_type) -1;
+
+	if (start > first)
+		mask &= (elem_type) -1 << (start - first);
+	if (end < first + ELEM_BITS)
+		mask &= ((elem_type) 1 << (end - first)) - 1;
+	return mask;
+}
+
+/* Returns the number of bits set in element E.  We avoid
+   __builtin_popcountl(), which needs libgcc without -mpopcnt. */
+static inline size_t
+elem_popcount (elem_type e) {
+	e = e - ((e >> 1) & 0x5555555555555555UL);
+	e = (e & 0x3333333333333333UL) + ((e >> 2) & 0x3333333333333333UL);
+	e = (e + (e >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (e * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the index of the first bit at or after START in B that
+   is set to VALUE, or B's size if there is none.  Skips whole
+   elements at a time and locates the bit with bsf. */
+static size_t
+find_next (const struct bitmap *b, size_t start, bool value) {
+	size_t idx = elem_idx (start);
+	size_t cnt = elem_cnt (b->bit_cnt);
+	elem_type flip = value ? 0 : (elem_type) -1;
+	elem_type e;
+	size_t bit;
+
+	if (start >= b->bit_cnt)
+		return b->bit_cnt;
+
+	e = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+	while (e == 0) {
+		if (++idx >= cnt)
+			return b->bit_cnt;
+		e = b->bits[idx] ^ flip;
+	}
+	bit = idx * ELEM_BITS + __builtin_ctzl (e);
+	return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
 
 /* Creation and destruction. */
 
@@ -194,48 +242,63 @@ bitmap_set_all (struct bitmap *b, bool value) {
 	bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
+	size_t idx;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		bitmap_set (b, start + i, value);
+	if (cnt == 0)
+		return;
+	for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++) {
+		elem_type mask = range_mask (idx, start, end);
+		if (value)
+			asm ("lock orq %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+		else
+			asm ("lock andq %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+	}
 }
 
 /* Returns the number of bits in B between START and START + CNT,
    exclusive, that are set to VALUE. */
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i, value_cnt;
+	size_t end = start + cnt;
+	size_t idx, set_cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
-	return value_cnt;
+	if (cnt == 0)
+		return 0;
+	set_cnt = 0;
+	for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+		set_cnt += elem_popcount (b->bits[idx] & range_mask (idx, start, end));
+	return value ? set_cnt : cnt - set_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
+	elem_type flip = value ? 0 : (elem_type) -1;
+	size_t idx;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
+	if (cnt == 0)
+		return false;
+	for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+		if ((b->bits[idx] ^ flip) & range_mask (idx, start, end))
 			return true;
 	return false;
 }
@@ -266,20 +329,40 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Rather than testing every candidate position, this jumps from
+   the start of one run of VALUE bits to the end of it, skipping
+   whole elements of !VALUE or VALUE bits at a time. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
+	size_t i;
+
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
-	if (cnt <= b->bit_cnt) {
-		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
-				return i;
+	if (cnt > b->bit_cnt || start > b->bit_cnt - cnt)
+		return BITMAP_ERROR;
+	if (cnt == 0)
+		return start;
+
+	/* Fast path: a single bit is just the next VALUE bit. */
+	if (cnt == 1) {
+		i = find_next (b, start, value);
+		return i < b->bit_cnt ? i : BITMAP_ERROR;
+	}
+
+	for (i = start; ; ) {
+		size_t run_end;
+
+		i = find_next (b, i, value);
+		if (i >= b->bit_cnt || cnt > b->bit_cnt - i)
+			return BITMAP_ERROR;
+		run_end = find_next (b, i, !value);
+		if (run_end - i >= cnt)
+			return i;
+		i = run_end;
 	}
-	return BITMAP_ERROR;
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -326,6 +409,23 @@ bitmap_write (const struct bitmap *b, struct file *file) {
 	off_t size = byte_cnt (b->bit_cnt);
 	return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes bytes OFS through OFS + SIZE of B's file image to the
+   same offsets in FILE, which must already hold the rest of B.
+   SIZE is clipped to the end of the image.  Return true if
+   successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+		off_t ofs, off_t size) {
+	off_t file_size = byte_cnt (b->bit_cnt);
+	ASSERT (ofs >= 0 && size >= 0);
+	if (ofs >= file_size)
+		return true;
+	if (size > file_size - ofs)
+		size = file_size - ofs;
+	return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+		== size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
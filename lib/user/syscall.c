@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -194,3 +194,70 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+pread (int fd, void *buffer, unsigned size, off_t offset) {
+	return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, off_t offset) {
+	return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+		unsigned length) {
+	return syscall5 (SYS_COPY_FILE_RANGE, fd_in, off_in, fd_out, off_out,
+			length);
+}
+
+struct uring *
+uring_setup (unsigned entries) {
+	return (struct uring *) syscall1 (SYS_URING_SETUP, entries);
+}
+
+int
+uring_enter (unsigned to_submit, unsigned min_complete) {
+	return syscall2 (SYS_URING_ENTER, to_submit, min_complete);
+}
+
+pid_t
+spawn (const char *file, char *const argv[]) {
+	return (pid_t) syscall2 (SYS_SPAWN, file, argv);
+}
+
+/* The child runs on the parent's stack until it calls exec() or
+   exit(), and may overwrite this function's return address
+   before the parent returns.  So keep the return address in a
+   register, which the system call preserves, instead of on the
+   stack. */
+__attribute__((naked)) pid_t
+vfork (void) {
+	asm volatile (
+			"popq %%rdx\n"
+			"movq %0, %%rax\n"
+			"syscall\n"
+			"jmp *%%rdx\n"
+			: : "i" (SYS_VFORK));
+}
+
+int
+fsync (int fd) {
+	return syscall1 (SYS_FSYNC, fd);
+}
+
+int
+fallocate (int fd, off_t offset, off_t len) {
+	return syscall3 (SYS_FALLOCATE, fd, offset, len);
+}
@@ -0,0 +1,74 @@
+#include <syscall.h>
+#include <stdint.h>
+#include <vdso.h>
+
+/* Reads the processor's time-stamp counter. */
+static inline uint64_t
+rdtsc (void) {
+	uint32_t lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* Copies a consistent snapshot of VDSO_DATA into D, retrying
+   while the timer interrupt is in the middle of updating it. */
+static void
+read_data (struct vdso_data *d) {
+	const struct vdso_data *v = VDSO_DATA;
+	uint64_t seq;
+
+	do {
+		seq = v->seq;
+		asm volatile ("" : : : "memory");
+		d->ticks = v->ticks;
+		d->tick_tsc = v->tick_tsc;
+		d->tsc_per_tick = v->tsc_per_tick;
+		d->timer_freq = v->timer_freq;
+		asm volatile ("" : : : "memory");
+	} while ((seq & 1) != 0 || seq != v->seq);
+}
+
+/* Returns the number of timer ticks since the OS booted. */
+int64_t
+get_ticks (void) {
+	struct vdso_data d;
+
+	read_data (&d);
+	return d.ticks;
+}
+
+/* Returns the kernel's estimate of TSC cycles per timer tick, or
+   0 if it has none yet. */
+uint64_t
+get_tsc_per_tick (void) {
+	struct vdso_data d;
+
+	read_data (&d);
+	return d.tsc_per_tick;
+}
+
+/* Returns nanoseconds since the OS booted.  Between ticks the
+   time is interpolated with the TSC, once the kernel has
+   calibrated it. */
+uint64_t
+get_time_ns (void) {
+	struct vdso_data d;
+	uint64_t ns, tsc;
+
+	read_data (&d);
+	tsc = rdtsc ();
+	ns = (uint64_t) d.ticks * 1000000000 / d.timer_freq;
+	if (d.tsc_per_tick != 0 && tsc > d.tick_tsc) {
+		uint64_t delta = tsc - d.tick_tsc;
+		if (delta > d.tsc_per_tick)
+			delta = d.tsc_per_tick;
+		ns += delta * (1000000000 / d.timer_freq) / d.tsc_per_tick;
+	}
+	return ns;
+}
+
+/* Returns the calling process's pid. */
+pid_t
+getpid (void) {
+	return VDSO_PROC->pid;
+}
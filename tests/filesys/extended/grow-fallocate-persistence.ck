@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"testfile" => ["a" x 2000 . "\0" x 4000 . "b" x 1000]});
+pass;
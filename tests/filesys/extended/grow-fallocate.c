@@ -0,0 +1,56 @@
+/* Reserves space with fallocate() and checks that the file length
+   only changes once data is written, including into the reserved
+   range and past a gap that must read back as zeros.  Also checks
+   that fallocate() rejects bad ranges. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[7000];
+
+static void
+check_length (int fd, int length)
+{
+  if (filesize (fd) != length)
+    fail ("file length should be %d, actually %d", length, filesize (fd));
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "testfile";
+  int fd;
+
+  memset (buf, 'a', 2000);
+  memset (buf + 6000, 'b', 1000);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  CHECK (fallocate (fd, 0, 5000) == 0, "fallocate 5000 bytes");
+  check_length (fd, 0);
+  CHECK (write (fd, buf, 2000) == 2000, "write into the reserved range");
+  check_length (fd, 2000);
+
+  CHECK (fallocate (fd, 0, 1000) == 0, "fallocate inside the file");
+  CHECK (fallocate (fd, 8000, 2000) == 0, "fallocate past end of file");
+  check_length (fd, 2000);
+
+  msg ("seek \"%s\"", file_name);
+  seek (fd, 6000);
+  CHECK (write (fd, buf + 6000, 1000) == 1000, "write past a gap");
+  check_length (fd, 7000);
+
+  CHECK (fallocate (fd, -1, 100) == -1, "fallocate at negative offset fails");
+  CHECK (fallocate (fd, 0, 0) == -1, "fallocate of 0 bytes fails");
+  CHECK (fallocate (fd, 0, -100) == -1, "fallocate of negative length fails");
+  CHECK (fallocate (fd, 0x7fffff00, 0x1000) == -1,
+         "fallocate past the largest offset fails");
+  check_length (fd, 7000);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
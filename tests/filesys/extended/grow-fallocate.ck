@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fallocate) begin
+(grow-fallocate) create "testfile"
+(grow-fallocate) open "testfile"
+(grow-fallocate) fallocate 5000 bytes
+(grow-fallocate) write into the reserved range
+(grow-fallocate) fallocate inside the file
+(grow-fallocate) fallocate past end of file
+(grow-fallocate) seek "testfile"
+(grow-fallocate) write past a gap
+(grow-fallocate) fallocate at negative offset fails
+(grow-fallocate) fallocate of 0 bytes fails
+(grow-fallocate) fallocate of negative length fails
+(grow-fallocate) fallocate past the largest offset fails
+(grow-fallocate) close "testfile"
+(grow-fallocate) open "testfile" for verification
+(grow-fallocate) verified contents of "testfile"
+(grow-fallocate) close "testfile"
+(grow-fallocate) end
+EOF
+pass;
@@ -0,0 +1,134 @@
+/* Test program and microbenchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count() and bitmap_contains()
+   against a bit-by-bit reference on random bitmaps, then times
+   bitmap_scan_and_flip() on a large, mostly full bitmap like the
+   ones behind palloc and the free map.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Maximum number of bits in a bitmap that we will check. */
+#define MAX_BITS 300
+
+/* Number of bits in the benchmark bitmap: a 512 MB pool of
+   pages, or a 64 MB disk of sectors. */
+#define BENCH_BITS (128 * 1024)
+
+/* Number of allocations made by each benchmark round. */
+#define BENCH_ALLOCS 2048
+
+static size_t reference_scan (const struct bitmap *, size_t start,
+                              size_t cnt, bool);
+static void verify_bitmap (const struct bitmap *);
+static void benchmark (size_t cnt);
+
+/* Test the bitmap implementation. */
+void
+test (void)
+{
+  size_t bit_cnt;
+
+  printf ("testing various size bitmaps:");
+  for (bit_cnt = 0; bit_cnt <= MAX_BITS; bit_cnt = bit_cnt * 4 / 3 + 1)
+    {
+      int repeat;
+
+      printf (" %zu", bit_cnt);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          struct bitmap *b = bitmap_create (bit_cnt);
+          unsigned density = random_ulong () % 101;
+          size_t i;
+
+          ASSERT (b != NULL);
+          for (i = 0; i < bit_cnt; i++)
+            bitmap_set (b, i, random_ulong () % 100 < density);
+          verify_bitmap (b);
+          bitmap_destroy (b);
+        }
+    }
+  printf (" done\n");
+
+  benchmark (1);
+  benchmark (8);
+  printf ("bitmap: PASS\n");
+}
+
+/* Returns the first group of CNT bits at or after START in B that
+   are all VALUE, testing one bit at a time. */
+static size_t
+reference_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, j;
+
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Checks the word-at-a-time operations on every range of B. */
+static void
+verify_bitmap (const struct bitmap *b)
+{
+  size_t bit_cnt = bitmap_size (b);
+  size_t start, cnt;
+
+  for (start = 0; start <= bit_cnt; start++)
+    for (cnt = 0; start + cnt <= bit_cnt; cnt = cnt * 2 + 1)
+      {
+        size_t set_cnt = 0;
+        size_t i;
+
+        for (i = 0; i < cnt; i++)
+          set_cnt += bitmap_test (b, start + i);
+
+        ASSERT (bitmap_count (b, start, cnt, true) == set_cnt);
+        ASSERT (bitmap_count (b, start, cnt, false) == cnt - set_cnt);
+        ASSERT (bitmap_contains (b, start, cnt, true) == (set_cnt > 0));
+        ASSERT (bitmap_contains (b, start, cnt, false) == (set_cnt < cnt));
+        ASSERT (bitmap_scan (b, start, cnt, true)
+                == reference_scan (b, start, cnt, true));
+        ASSERT (bitmap_scan (b, start, cnt, false)
+                == reference_scan (b, start, cnt, false));
+      }
+}
+
+/* Times BENCH_ALLOCS allocations of CNT bits from a bitmap that is
+   full except for scattered holes near its end, so that every
+   first-fit scan has to cross most of the bitmap. */
+static void
+benchmark (size_t cnt)
+{
+  struct bitmap *b = bitmap_create (BENCH_BITS);
+  int64_t start;
+  size_t i;
+
+  ASSERT (b != NULL);
+  bitmap_set_all (b, true);
+  for (i = 0; i < BENCH_ALLOCS; i++)
+    bitmap_set_multiple (b, BENCH_BITS - (i + 1) * 16, cnt, false);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_ALLOCS; i++)
+    ASSERT (bitmap_scan_and_flip (b, 0, cnt, false) != BITMAP_ERROR);
+  printf ("%d allocations of %zu bits from %d bits: %"PRId64" ticks\n",
+          BENCH_ALLOCS, cnt, BENCH_BITS, timer_elapsed (start));
+
+  bitmap_destroy (b);
+}
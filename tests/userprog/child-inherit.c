@@ -0,0 +1,35 @@
+/* Child process run by spawn-inherit and vfork-inherit.
+
+   Reads sample.txt through the file descriptor passed as the
+   first command-line argument, then opens "marker", which exists
+   only in the directory the parent changed into. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+
+const char *test_name = "child-inherit";
+
+int
+main (int argc, char *argv[]) 
+{
+  int handle;
+
+  msg ("begin");
+
+  if (argc != 2 || !isdigit (*argv[1]))
+    fail ("bad command-line arguments");
+
+  handle = atoi (argv[1]);
+  check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+  close (handle);
+
+  CHECK ((handle = open ("marker")) > 1,
+         "open \"marker\" in the inherited directory");
+  close (handle);
+
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,62 @@
+/* Copies with copy_file_range(): a whole file at the file
+   positions, a piece at explicit offsets, a range running past
+   the end of the input, and ranges within one file. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LEN ((int) sizeof sample - 1)
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  off_t off_in, off_out;
+  int in, out;
+
+  CHECK (create ("copy.txt", 0), "create \"copy.txt\"");
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((out = open ("copy.txt")) > 1, "open \"copy.txt\"");
+
+  /* Whole file, at and moving the file positions. */
+  CHECK (copy_file_range (in, NULL, out, NULL, LEN) == LEN,
+         "copy sample.txt to copy.txt");
+  CHECK (tell (in) == LEN && tell (out) == LEN, "file positions moved");
+  check_file ("copy.txt", sample, LEN);
+
+  /* A piece at explicit offsets, which leaves the positions. */
+  off_in = 100;
+  off_out = 10;
+  CHECK (copy_file_range (in, &off_in, out, &off_out, 50) == 50,
+         "copy 50 bytes at explicit offsets");
+  CHECK (off_in == 150 && off_out == 60, "offsets advanced");
+  CHECK (tell (in) == LEN && tell (out) == LEN, "file positions unchanged");
+  CHECK (pread (out, buf, 50, 10) == 50, "pread the copied bytes");
+  compare_bytes (buf, sample + 100, 50, 10, "copy.txt");
+
+  /* Past the end of the input. */
+  off_in = LEN - 20;
+  off_out = 0;
+  CHECK (copy_file_range (in, &off_in, out, &off_out, 1000) == 20,
+         "copy stops at end of input");
+  off_in = LEN + 100;
+  CHECK (copy_file_range (in, &off_in, out, &off_out, 10) == 0,
+         "copy from past end of input copies nothing");
+  CHECK (off_in == LEN + 100 && off_out == 20, "offsets unchanged");
+
+  /* Within one file: a disjoint range appends a second copy, an
+     overlapping one is refused. */
+  off_in = 0;
+  off_out = LEN;
+  CHECK (copy_file_range (in, &off_in, in, &off_out, 50) == 50,
+         "copy within sample.txt");
+  CHECK (filesize (in) == LEN + 50, "sample.txt grew by 50 bytes");
+  CHECK (pread (in, buf, 50, LEN) == 50, "pread the copied bytes");
+  compare_bytes (buf, sample, 50, LEN, "sample.txt");
+  off_in = 0;
+  off_out = 10;
+  CHECK (copy_file_range (in, &off_in, in, &off_out, 50) == -1,
+         "overlapping copy within sample.txt fails");
+}
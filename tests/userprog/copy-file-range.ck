@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-file-range) begin
+(copy-file-range) create "copy.txt"
+(copy-file-range) open "sample.txt"
+(copy-file-range) open "copy.txt"
+(copy-file-range) copy sample.txt to copy.txt
+(copy-file-range) file positions moved
+(copy-file-range) open "copy.txt" for verification
+(copy-file-range) verified contents of "copy.txt"
+(copy-file-range) close "copy.txt"
+(copy-file-range) copy 50 bytes at explicit offsets
+(copy-file-range) offsets advanced
+(copy-file-range) file positions unchanged
+(copy-file-range) pread the copied bytes
+(copy-file-range) copy stops at end of input
+(copy-file-range) copy from past end of input copies nothing
+(copy-file-range) offsets unchanged
+(copy-file-range) copy within sample.txt
+(copy-file-range) sample.txt grew by 50 bytes
+(copy-file-range) pread the copied bytes
+(copy-file-range) overlapping copy within sample.txt fails
+(copy-file-range) end
+copy-file-range: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Reads pieces of sample.txt with pread() at explicit offsets,
+   and checks that the file position does not move. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, buf, 10) == 10, "read 10 bytes");
+
+  CHECK (pread (handle, buf, 20, 100) == 20, "pread 20 bytes at offset 100");
+  compare_bytes (buf, sample + 100, 20, 100, "sample.txt");
+  CHECK (pread (handle, buf, sizeof sample, 300) == sizeof sample - 301,
+         "pread at offset 300 stops at end of file");
+  compare_bytes (buf, sample + 300, sizeof sample - 301, 300, "sample.txt");
+  CHECK (pread (handle, buf, 10, sizeof sample + 100) == 0,
+         "pread past end of file returns 0");
+  CHECK (pread (handle, buf, 10, -1) == -1, "pread at negative offset fails");
+  CHECK (tell (handle) == 10, "file position is still 10");
+
+  CHECK (read (handle, buf, 10) == 10, "read 10 more bytes");
+  compare_bytes (buf, sample + 10, 10, 10, "sample.txt");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-normal) begin
+(pread-normal) open "sample.txt"
+(pread-normal) read 10 bytes
+(pread-normal) pread 20 bytes at offset 100
+(pread-normal) pread at offset 300 stops at end of file
+(pread-normal) pread past end of file returns 0
+(pread-normal) pread at negative offset fails
+(pread-normal) file position is still 10
+(pread-normal) read 10 more bytes
+(pread-normal) end
+pread-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,27 @@
+/* Writes sample.txt into a new file with pwrite(), back half
+   first, and checks that the file position does not move. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t half = (sizeof sample - 1) / 2;
+  int handle;
+
+  CHECK (create ("test.txt", sizeof sample - 1), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  CHECK (pwrite (handle, sample + half, sizeof sample - 1 - half, half)
+         == (int) (sizeof sample - 1 - half), "pwrite back half");
+  CHECK (pwrite (handle, sample, half, 0) == (int) half, "pwrite front half");
+  CHECK (pwrite (handle, sample, 10, -1) == -1,
+         "pwrite at negative offset fails");
+  CHECK (tell (handle) == 0, "file position is still 0");
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
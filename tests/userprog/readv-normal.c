@@ -0,0 +1,33 @@
+/* Reads sample.txt with one readv() into three buffers, one of
+   them empty and one crossing a page boundary, and checks that
+   the file position moves past everything read. */
+
+#include <syscall.h>
+#include "tests/userprog/boundary.h"
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char head[50];
+  char *tail = (char *) get_boundary_area () - 100;
+  struct iovec iov[3] = {
+    { head, sizeof head },
+    { NULL, 0 },
+    { tail, sizeof sample - 1 - sizeof head },
+  };
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (readv (handle, iov, 3) == sizeof sample - 1, "readv into 3 buffers");
+  compare_bytes (head, sample, sizeof head, 0, "sample.txt");
+  compare_bytes (tail, sample + sizeof head, sizeof sample - 1 - sizeof head,
+                 sizeof head, "sample.txt");
+  CHECK (tell (handle) == sizeof sample - 1, "file position is at end of file");
+
+  CHECK (readv (handle, iov, -1) == -1, "readv with negative count fails");
+  CHECK (readv (handle, iov, IOV_MAX + 1) == -1,
+         "readv with too many buffers fails");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-normal) begin
+(readv-normal) open "sample.txt"
+(readv-normal) readv into 3 buffers
+(readv-normal) file position is at end of file
+(readv-normal) readv with negative count fails
+(readv-normal) readv with too many buffers fails
+(readv-normal) end
+readv-normal: exit(0)
+EOF
+pass;
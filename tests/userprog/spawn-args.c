@@ -0,0 +1,15 @@
+/* Tests argument passing to spawned child processes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char *argv[] = {"child-args", "childarg", NULL};
+  pid_t pid;
+
+  CHECK ((pid = spawn ("child-args", argv)) > 0, "spawn \"child-args\"");
+  msg ("wait(spawn()) = %d", wait (pid));
+}
@@ -0,0 +1,31 @@
+/* Opens a file and changes into a new directory, then spawns a
+   child that reads the file through the inherited descriptor and
+   opens a file relative to the inherited current directory.
+   Reading in the child must not move the parent's position. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char fd_str[16];
+  char *argv[] = {"child-inherit", fd_str, NULL};
+  int handle;
+  pid_t pid;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (create ("d/marker", 0), "create \"d/marker\"");
+  CHECK (chdir ("d"), "chdir \"d\"");
+  snprintf (fd_str, sizeof fd_str, "%d", handle);
+
+  CHECK ((pid = spawn ("/child-inherit", argv)) > 0,
+         "spawn \"/child-inherit\"");
+  msg ("wait(spawn()) = %d", wait (pid));
+
+  check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-inherit) begin
+(spawn-inherit) open "sample.txt"
+(spawn-inherit) mkdir "d"
+(spawn-inherit) create "d/marker"
+(spawn-inherit) chdir "d"
+(spawn-inherit) spawn "/child-inherit"
+(child-inherit) begin
+(child-inherit) verified contents of "sample.txt"
+(child-inherit) open "marker" in the inherited directory
+(child-inherit) end
+/child-inherit: exit(0)
+(spawn-inherit) wait(spawn()) = 0
+(spawn-inherit) verified contents of "sample.txt"
+(spawn-inherit) end
+spawn-inherit: exit(0)
+EOF
+pass;
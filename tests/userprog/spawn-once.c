@@ -0,0 +1,15 @@
+/* Spawns a single child process and waits for it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char *argv[] = {"child-simple", NULL};
+  pid_t pid;
+
+  CHECK ((pid = spawn ("child-simple", argv)) > 0, "spawn \"child-simple\"");
+  msg ("wait(spawn()) = %d", wait (pid));
+}
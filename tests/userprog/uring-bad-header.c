@@ -0,0 +1,55 @@
+/* Rewrites the ring sizes and moves the head and tail counters far
+   past the end of the ring.  The kernel must index the ring with
+   the sizes it chose in uring_setup(), so submissions still land
+   in the right slots and nothing outside the ring is touched. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FAR 0x10000000
+
+void
+test_main (void)
+{
+  struct uring *ring;
+  struct uring_sqe *sqes;
+  struct uring_cqe *cqes;
+  unsigned sq_entries, cq_entries;
+  int i;
+
+  CHECK ((ring = uring_setup (4)) != NULL, "uring_setup");
+  sq_entries = ring->sq_entries;
+  cq_entries = ring->cq_entries;
+  sqes = URING_SQES (ring);
+  cqes = URING_CQES (ring, sq_entries);
+
+  ring->sq_entries = ring->cq_entries = 0x80000000;
+  ring->sq_head = ring->sq_tail = FAR;
+  ring->cq_head = ring->cq_tail = FAR;
+  msg ("corrupt the ring header");
+
+  for (i = 0; i < 4; i++)
+    {
+      struct uring_sqe *sqe = &sqes[(FAR + i) & (sq_entries - 1)];
+      sqe->opcode = URING_OP_NOP;
+      sqe->user_data = i;
+    }
+  ring->sq_tail = FAR + 4;
+  CHECK (uring_enter (4, 4) == 4, "submit 4 NOPs");
+
+  for (i = 0; i < 4; i++)
+    {
+      struct uring_cqe *cqe = &cqes[(FAR + i) & (cq_entries - 1)];
+      if (cqe->user_data != (uint64_t) i || cqe->res != 0)
+        fail ("completion %d is in the wrong slot", i);
+    }
+  CHECK (ring->cq_tail == FAR + 4, "completions are in their slots");
+
+  /* A tail far ahead of the head only replays slots inside the
+     ring, and no more than the CQ can hold. */
+  ring->cq_head = ring->cq_tail;
+  ring->sq_tail = ring->sq_head + FAR;
+  CHECK (uring_enter (FAR, 0) == (int) cq_entries,
+         "bogus SQ tail consumes one CQ's worth");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(uring-bad-header) begin
+(uring-bad-header) uring_setup
+(uring-bad-header) corrupt the ring header
+(uring-bad-header) submit 4 NOPs
+(uring-bad-header) completions are in their slots
+(uring-bad-header) bogus SQ tail consumes one CQ's worth
+(uring-bad-header) end
+uring-bad-header: exit(0)
+EOF
+pass;
@@ -0,0 +1,94 @@
+/* Copies sample.txt to a new file through the ring: opens both
+   files, reads one and writes the other, then closes both, each
+   step as one batch submitted with a single uring_enter(). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct uring *ring;
+static int res[8];
+static char buf[sizeof sample];
+
+/* Queues an SQE whose completion is stored in res[USER_DATA]. */
+static void
+queue (uint8_t opcode, int fd, const void *addr, size_t len, int off,
+       int user_data)
+{
+  struct uring_sqe *sqe =
+    &URING_SQES (ring)[ring->sq_tail & (ring->sq_entries - 1)];
+
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) addr;
+  sqe->len = len;
+  sqe->off = off;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+/* Submits CNT queued SQEs, waits for their completions and
+   stores each result in res[]. */
+static void
+submit_and_wait (int cnt)
+{
+  struct uring_cqe *cqes = URING_CQES (ring, ring->sq_entries);
+  int i;
+
+  if (uring_enter (cnt, cnt) != cnt)
+    fail ("uring_enter() did not consume %d SQEs", cnt);
+  for (i = 0; i < cnt; i++)
+    {
+      struct uring_cqe *cqe;
+
+      if (ring->cq_head == ring->cq_tail)
+        fail ("missing completion");
+      cqe = &cqes[ring->cq_head & (ring->cq_entries - 1)];
+      res[cqe->user_data] = cqe->res;
+      ring->cq_head++;
+    }
+}
+
+void
+test_main (void)
+{
+  int in, out;
+
+  CHECK (create ("copy.txt", sizeof sample - 1), "create \"copy.txt\"");
+  CHECK ((ring = uring_setup (4)) != NULL, "uring_setup");
+  CHECK (uring_setup (4) == NULL, "second uring_setup fails");
+
+  queue (URING_OP_OPEN, 0, "sample.txt", 0, 0, 0);
+  queue (URING_OP_OPEN, 0, "copy.txt", 0, 0, 1);
+  queue (URING_OP_NOP, 0, NULL, 0, 0, 2);
+  queue (URING_OP_OPEN, 0, "no-such-file", 0, 0, 3);
+  submit_and_wait (4);
+  in = res[0];
+  out = res[1];
+  CHECK (in > 1 && out > 1 && in != out, "open both files in one batch");
+  CHECK (res[2] == 0, "nop succeeds");
+  CHECK (res[3] == -1, "open of a missing file fails");
+
+  queue (URING_OP_READ, in, buf, 100, 0, 4);
+  queue (URING_OP_READ, in, buf + 100, sizeof sample - 101, 100, 5);
+  submit_and_wait (2);
+  CHECK (res[4] == 100 && res[5] == (int) sizeof sample - 101,
+         "read sample.txt in two pieces");
+
+  queue (URING_OP_WRITE, out, buf, sizeof sample - 1, 0, 6);
+  submit_and_wait (1);
+  CHECK (res[6] == (int) sizeof sample - 1, "write copy.txt");
+
+  queue (URING_OP_CLOSE, in, NULL, 0, 0, 6);
+  queue (URING_OP_CLOSE, out, NULL, 0, 0, 7);
+  submit_and_wait (2);
+  CHECK (res[6] == 0 && res[7] == 0, "close both files");
+
+  queue (URING_OP_CLOSE, in, NULL, 0, 0, 7);
+  submit_and_wait (1);
+  CHECK (res[7] == -1, "close of a closed fd fails");
+
+  check_file ("copy.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(uring-batch) begin
+(uring-batch) create "copy.txt"
+(uring-batch) uring_setup
+(uring-batch) second uring_setup fails
+(uring-batch) open both files in one batch
+(uring-batch) nop succeeds
+(uring-batch) open of a missing file fails
+(uring-batch) read sample.txt in two pieces
+(uring-batch) write copy.txt
+(uring-batch) close both files
+(uring-batch) close of a closed fd fails
+(uring-batch) open "copy.txt" for verification
+(uring-batch) verified contents of "copy.txt"
+(uring-batch) close "copy.txt"
+(uring-batch) end
+uring-batch: exit(0)
+EOF
+pass;
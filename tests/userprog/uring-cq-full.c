@@ -0,0 +1,64 @@
+/* Leaves completions unconsumed until the CQ is full, and checks
+   that uring_enter() then stops consuming SQEs instead of
+   overwriting completions, and resumes once the CQ drains. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct uring *ring;
+
+/* Queues a NOP whose completion carries USER_DATA. */
+static void
+queue_nop (int user_data)
+{
+  struct uring_sqe *sqe =
+    &URING_SQES (ring)[ring->sq_tail & (ring->sq_entries - 1)];
+
+  sqe->opcode = URING_OP_NOP;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+/* Consumes the next CQE and checks that it carries USER_DATA. */
+static void
+reap (int user_data)
+{
+  struct uring_cqe *cqe = &URING_CQES (ring, ring->sq_entries)
+    [ring->cq_head & (ring->cq_entries - 1)];
+
+  if (ring->cq_head == ring->cq_tail)
+    fail ("missing completion for %d", user_data);
+  if ((int) cqe->user_data != user_data || cqe->res != 0)
+    fail ("completion %d has user_data %d, res %d",
+          user_data, (int) cqe->user_data, cqe->res);
+  ring->cq_head++;
+}
+
+void
+test_main (void)
+{
+  int i;
+
+  CHECK ((ring = uring_setup (1)) != NULL, "uring_setup");
+  CHECK (ring->sq_entries == 1 && ring->cq_entries == 2,
+         "ring has 1 SQE and 2 CQEs");
+
+  for (i = 0; i < 2; i++)
+    {
+      queue_nop (i);
+      if (uring_enter (1, 0) != 1)
+        fail ("nop %d was not consumed", i);
+    }
+  msg ("fill the CQ");
+
+  queue_nop (2);
+  CHECK (uring_enter (1, 0) == 0, "uring_enter with a full CQ consumes nothing");
+  CHECK (ring->sq_head != ring->sq_tail, "SQE stays queued");
+
+  reap (0);
+  CHECK (uring_enter (1, 0) == 1, "uring_enter after reaping one CQE");
+  reap (1);
+  reap (2);
+  CHECK (ring->cq_head == ring->cq_tail, "all completions reaped in order");
+}
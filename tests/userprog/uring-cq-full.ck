@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(uring-cq-full) begin
+(uring-cq-full) uring_setup
+(uring-cq-full) ring has 1 SQE and 2 CQEs
+(uring-cq-full) fill the CQ
+(uring-cq-full) uring_enter with a full CQ consumes nothing
+(uring-cq-full) SQE stays queued
+(uring-cq-full) uring_enter after reaping one CQE
+(uring-cq-full) all completions reaped in order
+(uring-cq-full) end
+uring-cq-full: exit(0)
+EOF
+pass;
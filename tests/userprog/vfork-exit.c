@@ -0,0 +1,23 @@
+/* vforks a child that exits without calling exec.  The parent
+   stays asleep until then, so the child's output comes first. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t self = getpid ();
+  pid_t pid;
+
+  if ((pid = vfork ()) == 0)
+    {
+      msg ("child run");
+      if (getpid () == self)
+        fail ("child sees the parent's pid");
+      exit (42);
+    }
+  msg ("wait(vfork()) = %d", wait (pid));
+  CHECK (pid != self && getpid () == self, "parent resumes with its own pid");
+}
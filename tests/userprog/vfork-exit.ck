@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vfork-exit) begin
+(vfork-exit) child run
+vfork-exit: exit(42)
+(vfork-exit) wait(vfork()) = 42
+(vfork-exit) parent resumes with its own pid
+(vfork-exit) end
+vfork-exit: exit(0)
+EOF
+pass;
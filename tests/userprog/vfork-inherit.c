@@ -0,0 +1,34 @@
+/* Opens a file and changes into a new directory, then vforks a
+   child that execs child-inherit, which reads the file through the
+   inherited descriptor and opens a file relative to the inherited
+   current directory.  Reading in the child must not move the
+   parent's position. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char child_cmd[128];
+  int handle;
+  pid_t pid;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (create ("d/marker", 0), "create \"d/marker\"");
+  CHECK (chdir ("d"), "chdir \"d\"");
+  snprintf (child_cmd, sizeof child_cmd, "/child-inherit %d", handle);
+
+  if ((pid = vfork ()) == 0)
+    {
+      exec (child_cmd);
+      exit (-1);
+    }
+  msg ("wait(vfork()) = %d", wait (pid));
+
+  check_file_handle (handle, "sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vfork-inherit) begin
+(vfork-inherit) open "sample.txt"
+(vfork-inherit) mkdir "d"
+(vfork-inherit) create "d/marker"
+(vfork-inherit) chdir "d"
+(child-inherit) begin
+(child-inherit) verified contents of "sample.txt"
+(child-inherit) open "marker" in the inherited directory
+(child-inherit) end
+vfork-inherit: exit(0)
+(vfork-inherit) wait(vfork()) = 0
+(vfork-inherit) verified contents of "sample.txt"
+(vfork-inherit) end
+vfork-inherit: exit(0)
+EOF
+pass;
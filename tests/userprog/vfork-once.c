@@ -0,0 +1,22 @@
+/* vforks a child that execs child-simple, and checks that the
+   parent resumes with the child's pid and sees its own pid again
+   once the child has given back the address space. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t self = getpid ();
+  pid_t pid;
+
+  if ((pid = vfork ()) == 0)
+    {
+      exec ("child-simple");
+      exit (-1);
+    }
+  msg ("wait(vfork()) = %d", wait (pid));
+  CHECK (pid != self && getpid () == self, "parent resumes with its own pid");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vfork-once) begin
+(child-simple) run
+vfork-once: exit(81)
+(vfork-once) wait(vfork()) = 81
+(vfork-once) parent resumes with its own pid
+(vfork-once) end
+vfork-once: exit(0)
+EOF
+pass;
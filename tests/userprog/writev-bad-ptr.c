@@ -0,0 +1,23 @@
+/* Passes an iovec whose second buffer is an invalid pointer to
+   the writev system call.  The process must be terminated with -1
+   exit code. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct iovec iov[2] = {
+    { sample, 10 },
+    { (void *) 0x20101234, 10 },
+  };
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  writev (handle, iov, 2);
+  fail ("should not have survived writev()");
+}
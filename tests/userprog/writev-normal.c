@@ -0,0 +1,31 @@
+/* Writes sample.txt into a new file with one writev() from three
+   buffers, one of them empty and one crossing a page boundary. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/boundary.h"
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char *tail = (char *) get_boundary_area () - 100;
+  struct iovec iov[3] = {
+    { sample, 50 },
+    { NULL, 0 },
+    { tail, sizeof sample - 1 - 50 },
+  };
+  int handle;
+
+  memcpy (tail, sample + 50, sizeof sample - 1 - 50);
+  CHECK (create ("test.txt", sizeof sample - 1), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (writev (handle, iov, 3) == sizeof sample - 1,
+         "writev from 3 buffers");
+  CHECK (tell (handle) == sizeof sample - 1, "file position is at end of file");
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
@@ -27,6 +27,7 @@
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
@@ -100,6 +101,7 @@ main (void) {
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
+	vdso_init ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
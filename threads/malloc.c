@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +33,28 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor's free list sits a "magazine", a
+   small per-CPU stack of free blocks.  malloc() and free() first
+   try to pop from or push to the magazine, which only needs
+   interrupts disabled for a few instructions, and fall back to
+   the locked free list only when the magazine is empty or full,
+   moving MAG_BATCH blocks at a time.  Blocks in a magazine still
+   count as in use by their arena, so an arena is not returned to
+   the page allocator while any of its blocks are cached. */
+
+/* Magazine capacity and refill/drain batch size. */
+#define MAG_SIZE 16
+#define MAG_BATCH (MAG_SIZE / 2)
+
+/* Magazine of cached free blocks.  Pintos has a single CPU, so
+   there is one per descriptor, protected by disabling
+   interrupts. */
+struct magazine {
+	size_t cnt;                         /* Number of cached blocks. */
+	struct block *blocks[MAG_SIZE];     /* Cached blocks, a stack. */
+};
 
 /* Descriptor. */
 struct desc {
@@ -40,6 +62,7 @@ struct desc {
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	struct magazine mag;        /* Per-CPU cache of free blocks. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -63,6 +86,7 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void block_release (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -76,6 +100,7 @@ malloc_init (void) {
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
 		list_init (&d->free_list);
 		lock_init (&d->lock);
+		d->mag.cnt = 0;
 	}
 }
 
@@ -86,6 +111,7 @@ malloc (size_t size) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
+	enum intr_level old_level;
 
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
@@ -112,6 +138,15 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
+	/* Fast path: take a cached block from the magazine. */
+	old_level = intr_disable ();
+	if (d->mag.cnt > 0) {
+		b = d->mag.blocks[--d->mag.cnt];
+		intr_set_level (old_level);
+		return b;
+	}
+	intr_set_level (old_level);
+
 	lock_acquire (&d->lock);
 
 	/* If the free list is empty, create a new arena. */
@@ -139,6 +174,18 @@ malloc (size_t size) {
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
 	a->free_cnt--;
+
+	/* Refill the magazine with a batch of blocks that are already
+	   on the free list, so the next few calls skip the lock. */
+	old_level = intr_disable ();
+	while (d->mag.cnt < MAG_BATCH && !list_empty (&d->free_list)) {
+		struct block *c = list_entry (list_pop_front (&d->free_list),
+				struct block, free_elem);
+		block_to_arena (c)->free_cnt--;
+		d->mag.blocks[d->mag.cnt++] = c;
+	}
+	intr_set_level (old_level);
+
 	lock_release (&d->lock);
 	return b;
 }
@@ -207,29 +254,36 @@ free (void *p) {
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
+			struct block *drained[MAG_BATCH];
+			enum intr_level old_level;
+			size_t i;
 
 #ifndef NDEBUG
 			/* Clear the block to help detect use-after-free bugs. */
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			/* Fast path: cache the block in the magazine. */
+			old_level = intr_disable ();
+			if (d->mag.cnt < MAG_SIZE) {
+				d->mag.blocks[d->mag.cnt++] = b;
+				intr_set_level (old_level);
+				return;
 			}
 
+			/* The magazine is full.  Drain a batch of its oldest
+			   blocks back to the free list together with B. */
+			for (i = 0; i < MAG_BATCH; i++)
+				drained[i] = d->mag.blocks[i];
+			d->mag.cnt -= MAG_BATCH;
+			memmove (d->mag.blocks, d->mag.blocks + MAG_BATCH,
+					d->mag.cnt * sizeof *d->mag.blocks);
+			intr_set_level (old_level);
+
+			lock_acquire (&d->lock);
+			for (i = 0; i < MAG_BATCH; i++)
+				block_release (d, drained[i]);
+			block_release (d, b);
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
@@ -239,6 +293,31 @@ free (void *p) {
 	}
 }
 
+/* Adds block B back to the free list of descriptor D, and gives
+   its arena back to the page allocator if that leaves the arena
+   entirely unused.  D's lock must be held. */
+static void
+block_release (struct desc *d, struct block *b) {
+	struct arena *a = block_to_arena (b);
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+
+	/* Add block to free list. */
+	list_push_front (&d->free_list, &b->free_elem);
+
+	/* If the arena is now entirely unused, free it. */
+	if (++a->free_cnt >= d->blocks_per_arena) {
+		size_t i;
+
+		ASSERT (a->free_cnt == d->blocks_per_arena);
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			list_remove (&b->free_elem);
+		}
+		palloc_free_page (a);
+	}
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
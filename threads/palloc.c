@@ -2,14 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,12 +25,44 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  A free block of order K is 2**K pages long and
+   starts at a page index that is a multiple of 2**K.  Each order
+   has its own free list, so an allocation only has to pop the
+   smallest non-empty list and split it down, and a free only has
+   to merge with its buddy while the buddy is free, both in
+   O(log n).  The free-list links live in a per-page node array
+   kept next to the used_map, not in the free pages themselves,
+   because pages above the boot mapping are not accessible until
+   paging_init() runs.
+
+   The pool's free lists are also touched by palloc_free_page()
+   from do_schedule(), where interrupts are off and we must not
+   sleep on a lock, so they are protected by disabling
+   interrupts instead. */
+
+/* Number of buddy orders.  The largest block is 2**(ORDER_CNT-1)
+   pages, i.e. 4 GB. */
+#define BUDDY_ORDER_CNT 21
+
+/* Value of buddy_node.order for a page that does not head a free
+   block. */
+#define BUDDY_NONE -1
+
+/* Buddy bookkeeping for one page of a pool. */
+struct buddy_node {
+	struct list_elem elem;          /* Element in free_lists[order]. */
+	int order;                      /* Order of the free block headed
+	                                   here, or BUDDY_NONE. */
+};
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct buddy_node *nodes;       /* One node per page. */
+	struct list free_lists[BUDDY_ORDER_CNT]; /* Free blocks per order. */
 	uint8_t *base;                  /* Base of pool. */
 };
 
@@ -42,6 +75,8 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_alloc (struct pool *, size_t page_cnt);
+static void pool_release (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -223,12 +258,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_release (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_release (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,10 +297,7 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	size_t page_idx = page_cnt > 0 ? pool_alloc (pool, page_cnt) : BITMAP_ERROR;
 	void *pages;
 
 	if (page_idx != BITMAP_ERROR)
@@ -319,7 +351,7 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool_release (pool, page_idx, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -335,18 +367,156 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t bm_size = ROUND_UP (bitmap_buf_size (pgcnt), sizeof (void *));
+	size_t nodes_size = pgcnt * sizeof (struct buddy_node);
+	size_t bm_pages = DIV_ROUND_UP (bm_size + nodes_size, PGSIZE) * PGSIZE;
+	size_t i;
 
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_size);
+	p->nodes = (struct buddy_node *) ((uint8_t *) *bm_base + bm_size);
 	p->base = (void *) start;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	for (i = 0; i < pgcnt; i++)
+		p->nodes[i].order = BUDDY_NONE;
+	for (i = 0; i < BUDDY_ORDER_CNT; i++)
+		list_init (&p->free_lists[i]);
 
 	*bm_base += bm_pages;
 }
 
+/* Removes the free block headed at PAGE_IDX from POOL's free
+   lists. */
+static void
+buddy_unlink (struct pool *pool, size_t page_idx) {
+	struct buddy_node *node = &pool->nodes[page_idx];
+
+	ASSERT (node->order != BUDDY_NONE);
+	list_remove (&node->elem);
+	node->order = BUDDY_NONE;
+}
+
+/* Adds the block of order ORDER at PAGE_IDX to POOL's free lists
+   without trying to merge it. */
+static void
+buddy_link (struct pool *pool, size_t page_idx, int order) {
+	struct buddy_node *node = &pool->nodes[page_idx];
+
+	node->order = order;
+	list_push_front (&pool->free_lists[order], &node->elem);
+}
+
+/* Frees the block of order ORDER at PAGE_IDX, merging it with its
+   buddy for as long as the buddy is a free block of the same
+   order. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, int order) {
+	size_t pool_size = bitmap_size (pool->used_map);
+
+	while (order < BUDDY_ORDER_CNT - 1) {
+		size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy_idx + ((size_t) 1 << order) > pool_size
+				|| pool->nodes[buddy_idx].order != order)
+			break;
+		buddy_unlink (pool, buddy_idx);
+		if (buddy_idx < page_idx)
+			page_idx = buddy_idx;
+		order++;
+	}
+	buddy_link (pool, page_idx, order);
+}
+
+/* Returns the largest order of a buddy block that starts at
+   PAGE_IDX and spans no more than PAGE_CNT pages. */
+static int
+buddy_fit_order (size_t page_idx, size_t page_cnt) {
+	int order = 0;
+
+	while (order < BUDDY_ORDER_CNT - 1
+			&& page_idx % ((size_t) 2 << order) == 0
+			&& ((size_t) 2 << order) <= page_cnt)
+		order++;
+	return order;
+}
+
+/* Returns the smallest order whose block holds PAGE_CNT pages. */
+static int
+buddy_order (size_t page_cnt) {
+	int order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Hands the PAGE_CNT pages at PAGE_IDX back to the free lists of
+   POOL, splitting the range into the largest aligned blocks. */
+static void
+buddy_release_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	while (page_cnt > 0) {
+		int order = buddy_fit_order (page_idx, page_cnt);
+
+		buddy_free (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if no free block is
+   large enough.  Pages beyond PAGE_CNT in the chosen block are
+   returned to the free lists right away. */
+static size_t
+pool_alloc (struct pool *pool, size_t page_cnt) {
+	int order = buddy_order (page_cnt);
+	size_t page_idx = BITMAP_ERROR;
+	enum intr_level old_level;
+	int o;
+
+	if (order >= BUDDY_ORDER_CNT)
+		return BITMAP_ERROR;
+
+	old_level = intr_disable ();
+	for (o = order; o < BUDDY_ORDER_CNT; o++)
+		if (!list_empty (&pool->free_lists[o]))
+			break;
+	if (o < BUDDY_ORDER_CNT) {
+		struct buddy_node *node = list_entry (list_front (&pool->free_lists[o]),
+				struct buddy_node, elem);
+		page_idx = node - pool->nodes;
+		buddy_unlink (pool, page_idx);
+
+		/* Split down to the requested order, freeing the upper
+		   halves. */
+		while (o > order) {
+			o--;
+			buddy_link (pool, page_idx + ((size_t) 1 << o), o);
+		}
+
+		/* Give back the unused tail of a non-power-of-2 request. */
+		buddy_release_range (pool, page_idx + page_cnt,
+				((size_t) 1 << order) - page_cnt);
+
+		ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+		bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+	}
+	intr_set_level (old_level);
+
+	return page_idx;
+}
+
+/* Marks the PAGE_CNT pages at PAGE_IDX in POOL as free. */
+static void
+pool_release (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	enum intr_level old_level = intr_disable ();
+
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	buddy_release_range (pool, page_idx, page_cnt);
+	intr_set_level (old_level);
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
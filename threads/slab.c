@@ -0,0 +1,225 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator for fixed-size kernel objects.
+
+   Each cache hands out objects of a single size.  Objects are
+   carved out of "slabs", which are single pages obtained from
+   the page allocator.  A slab starts with a header that records
+   its owning cache and the indexes of its free objects, followed
+   by as many objects as fit in the rest of the page.  Unlike
+   malloc(), no size is rounded up to a power of 2, so objects are
+   packed densely and objects of one type share pages.
+
+   A cache keeps the slabs that still have free objects on a
+   "partial" list; allocation takes the first free object of the
+   first partial slab, and freeing finds the slab by rounding the
+   object's address down to a page boundary, so both run in
+   constant time.  Full slabs are on no list.  One completely free
+   slab is kept around to absorb alloc/free ping-pong; any other
+   slab that becomes empty is given back to the page allocator.
+
+   The free-object list is kept in the slab header rather than in
+   the objects, so an object keeps its contents while it is free.
+   A cache's constructor is run on every object once, when its slab
+   is created, and objects must be freed in that constructed
+   state. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* End of a slab's free-object list. */
+#define SLAB_NIL UINT16_MAX
+
+/* Object cache. */
+struct kmem_cache {
+	const char *name;           /* Name, for debugging. */
+	size_t obj_size;            /* Size of each object in bytes. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	size_t obj_ofs;             /* Offset of first object in a slab. */
+	kmem_ctor *ctor;            /* Object constructor, or null. */
+	struct list partial;        /* Slabs with at least one free object. */
+	size_t empty_cnt;           /* Completely free slabs on PARTIAL. */
+	struct lock lock;           /* Lock. */
+};
+
+/* Slab header, at the start of each slab page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in cache's partial list. */
+	size_t free_cnt;            /* Number of free objects. */
+	uint16_t free_head;         /* Index of first free object. */
+	uint16_t next[];            /* Next free object after each one. */
+};
+
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Returns the address of object IDX in slab S. */
+static inline void *
+slab_obj (struct kmem_cache *c, struct slab *s, size_t idx) {
+	return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
+}
+
+/* Creates and returns a cache named NAME for objects of SIZE
+   bytes.  If CTOR is non-null, it is run on each object when the
+   object's slab is created.  Panics if memory is not available,
+   since caches are created once at initialization time. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor) {
+	struct kmem_cache *c;
+	size_t n;
+
+	ASSERT (size > 0);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		PANIC ("kmem_cache_create: out of memory for %s", name);
+
+	c->name = name;
+	c->obj_size = ROUND_UP (size, sizeof (void *));
+	c->ctor = ctor;
+	list_init (&c->partial);
+	c->empty_cnt = 0;
+	lock_init (&c->lock);
+
+	/* Find the largest object count whose header and objects
+	   still fit in a page. */
+	for (n = (PGSIZE - sizeof (struct slab)) / c->obj_size; n > 0; n--) {
+		size_t ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+				sizeof (void *));
+		if (ofs + n * c->obj_size <= PGSIZE) {
+			c->obj_ofs = ofs;
+			break;
+		}
+	}
+	if (n == 0)
+		PANIC ("kmem_cache_create: %s objects (%zu bytes) do not fit in a page",
+				name, size);
+	c->objs_per_slab = n;
+	return c;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+
+	lock_acquire (&c->lock);
+
+	/* If no slab has a free object, create a new slab. */
+	if (list_empty (&c->partial)) {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->partial, &s->elem);
+		c->empty_cnt++;
+	}
+
+	/* Take the first free object of the first partial slab. */
+	s = list_entry (list_front (&c->partial), struct slab, elem);
+	ASSERT (s->free_cnt > 0);
+	if (s->free_cnt == c->objs_per_slab)
+		c->empty_cnt--;
+	obj = slab_obj (c, s, s->free_head);
+	s->free_head = s->next[s->free_head];
+	if (--s->free_cnt == 0)
+		list_remove (&s->elem);
+
+	lock_release (&c->lock);
+	return obj;
+}
+
+/* Frees OBJ, which must have been obtained from cache C with
+   kmem_cache_alloc(). */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+	size_t idx;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (c, obj);
+	idx = ((uint8_t *) obj - (uint8_t *) slab_obj (c, s, 0)) / c->obj_size;
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs, unless
+	   the cache relies on objects keeping their constructed state. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->obj_size);
+#endif
+
+	lock_acquire (&c->lock);
+
+	/* Push the object on its slab's free list. */
+	s->next[idx] = s->free_head;
+	s->free_head = idx;
+	if (s->free_cnt++ == 0)
+		list_push_front (&c->partial, &s->elem);
+
+	/* Keep one empty slab around, give back any other. */
+	if (s->free_cnt == c->objs_per_slab) {
+		if (c->empty_cnt > 0) {
+			list_remove (&s->elem);
+			s->magic = 0;
+			palloc_free_page (s);
+		} else
+			c->empty_cnt++;
+	}
+
+	lock_release (&c->lock);
+}
+
+/* Obtains a page from the page allocator, initializes it as an
+   empty slab of cache C, and returns it.
+   Returns a null pointer if memory is not available. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free_cnt = c->objs_per_slab;
+	s->free_head = 0;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_NIL;
+		if (c->ctor != NULL)
+			c->ctor (slab_obj (c, s, i));
+	}
+	return s;
+}
+
+/* Returns the slab of cache C that OBJ is inside. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	/* Check that the slab is valid. */
+	ASSERT (s != NULL);
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT (pg_ofs (obj) >= c->obj_ofs);
+	ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->obj_size == 0);
+
+	return s;
+}
@@ -452,7 +452,16 @@ init_thread (struct thread *t, const char *name, int priority) {
     list_init(&t->child_list);
 	list_init(&t->spt.mmap_list);
     t->exit_status = 0;
-    for(int i = 0; i < FDLIST_LEN; i++) { t->fd_table[i] = NULL; }
+    t->fd_table = NULL;
+    t->fd_map = NULL;
+    t->fd_cap = 0;
+#ifdef USERPROG
+    t->uring = NULL;
+    t->vfork_parent = NULL;
+#endif
+#ifdef FILESYS
+    t->cwd = NULL;
+#endif
 }
 
 bool
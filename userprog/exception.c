@@ -6,12 +6,49 @@
 #include "threads/thread.h"
 #include "intrinsic.h"
 #include "userprog/syscall.h"
+#include "threads/vaddr.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static bool fixup_exception (struct intr_frame *);
+
+/* Copies RDX bytes from RSI to RDI and returns the number of
+   bytes left uncopied, which is 0 unless the copy faulted.
+
+   The `rep movsb' at user_copy_insn is the only instruction that
+   may touch user memory.  If it faults on an address that
+   vm_try_handle_fault() cannot resolve, page_fault() finds it in
+   exception_table[] and resumes at user_copy_fixup, with RCX
+   still holding the number of bytes left to copy. */
+size_t user_copy (void *dst, const void *src, size_t size);
+extern const char user_copy_insn[], user_copy_fixup[];
+asm (".text\n"
+     ".globl user_copy\n"
+     ".type user_copy, @function\n"
+     "user_copy:\n"
+     "	movq %rdx, %rcx\n"
+     ".globl user_copy_insn\n"
+     "user_copy_insn:\n"
+     "	rep movsb\n"
+     ".globl user_copy_fixup\n"
+     "user_copy_fixup:\n"
+     "	movq %rcx, %rax\n"
+     "	ret\n"
+     ".size user_copy, . - user_copy\n");
+
+/* Kernel instructions that are allowed to fault on user memory,
+   and where to resume each of them when they do. */
+struct exception_entry {
+	const void *insn;           /* Faulting instruction. */
+	const void *fixup;          /* Where to continue. */
+};
+
+static const struct exception_entry exception_table[] = {
+	{ user_copy_insn, user_copy_fixup },
+};
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -61,6 +98,49 @@ exception_init (void) {
 	intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
 }
 
+/* Returns true if the SIZE bytes starting at UADDR all lie in
+   user virtual memory. */
+static bool
+is_user_range (const void *uaddr, size_t size) {
+	return is_user_vaddr (uaddr)
+		&& size <= (uint64_t) KERN_BASE - (uint64_t) uaddr;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+   Returns true if successful, false if any part of USRC is not
+   readable user memory, in which case DST may be partly
+   written. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	return is_user_range (usrc, size) && user_copy (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+   Returns true if successful, false if any part of UDST is not
+   writable user memory, in which case UDST may be partly
+   written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	return is_user_range (udst, size) && user_copy (udst, src, size) == 0;
+}
+
+/* Copies the NUL-terminated string at user address USRC into
+   kernel buffer DST, which has room for SIZE bytes.  Returns the
+   string's length, or -1 if USRC is not readable user memory or
+   the string does not fit. */
+int
+copy_str_from_user (char *dst, const char *usrc, size_t size) {
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (!copy_from_user (&dst[i], usrc + i, 1))
+			return -1;
+		if (dst[i] == '\0')
+			return i;
+	}
+	return -1;
+}
+
 /* Prints exception statistics. */
 void
 exception_print_stats (void) {
@@ -153,6 +233,11 @@ page_fault (struct intr_frame *f) {
         kern_exit(f, -1);
     }
 
+	/* A bad user pointer handed to copy_from_user() or
+	   copy_to_user(): make the copy return failure. */
+	if (fixup_exception (f))
+		return;
+
 	/* Count page faults. */
 	page_fault_cnt++;
 
@@ -165,3 +250,17 @@ page_fault (struct intr_frame *f) {
     kill (f); 
 }
 
+
+/* If F's faulting instruction is in exception_table[], redirects
+   F to its fixup and returns true.  Otherwise returns false. */
+static bool
+fixup_exception (struct intr_frame *f) {
+	size_t i;
+
+	for (i = 0; i < sizeof exception_table / sizeof *exception_table; i++)
+		if ((uintptr_t) exception_table[i].insn == f->rip) {
+			f->rip = (uintptr_t) exception_table[i].fixup;
+			return true;
+		}
+	return false;
+}
@@ -8,9 +8,12 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
+#include "userprog/uring.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
@@ -39,6 +42,10 @@ static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void **);
+static void __do_vfork (void *);
+static void spawnd (void *);
+static bool duplicate_fd_table (struct thread *parent, struct thread *child);
+static void vfork_release (struct thread *child);
 
 
 struct child_list_elem * process_set_child_list(struct thread *parent, struct thread *child);
@@ -118,6 +125,58 @@ process_fork (const char *name, struct intr_frame *if_) {
 	return child_pid;
 }
 
+/* Argument block for spawnd(), on the parent's stack. */
+struct spawn_info {
+    struct thread *parent;
+    char *cmd_line;                     /* Program name and arguments. */
+    struct semaphore loaded;            /* Upped once load() has finished. */
+    bool success;                       /* Did load() succeed? */
+};
+
+/* CMD_LINE의 프로그램을 새 프로세스로 바로 load한다. fork처럼 부모의 주소 공간을 복사하지 않는다.
+ * 자식은 부모의 fd를 물려받는다. load가 끝날 때까지 기다렸다가 자식의 pid를, 실패하면 -1을 돌려준다.
+ * CMD_LINE은 palloc한 page이고 이 함수가 해제한다. */
+tid_t
+process_spawn (char *cmd_line) {
+    struct spawn_info info;
+    char name[16], *save_ptr;
+    tid_t child_pid;
+
+    info.parent = thread_current();
+    info.cmd_line = cmd_line;
+    info.success = false;
+    sema_init(&info.loaded, 0);
+
+    strlcpy(name, cmd_line, sizeof name);
+    strtok_r(name, " ", &save_ptr);
+
+    child_pid = thread_create(name, PRI_DEFAULT, spawnd, &info);
+    if(child_pid != TID_ERROR) sema_down(&info.loaded);
+    palloc_free_page(cmd_line);
+
+    if(child_pid == TID_ERROR || !info.success) return -1;
+    return child_pid;
+}
+
+/* vfork: 자식이 exec하거나 종료할 때까지 부모의 주소 공간(pml4, spt)을 빌려 쓴다.
+ * 주소 공간을 복사하지 않으므로 fork + exec보다 빠르다. 그동안 부모는 잠들어 있다. */
+tid_t
+process_vfork (const char *name, struct intr_frame *if_) {
+    struct semaphore sema;
+    bool success = false;
+    void *arr[4] = {thread_current(), if_, &sema, &success};
+    tid_t child_pid;
+
+    sema_init(&sema, 0);
+
+    child_pid = thread_create (name, PRI_DEFAULT, __do_vfork, arr);
+    if(child_pid == TID_ERROR) return TID_ERROR;
+
+    /* 자식이 exec하거나 종료하면서 주소 공간을 돌려줄 때까지 기다린다. */
+    sema_down(&sema);
+    return success ? child_pid : -1;
+}
+
 
 int
 get_child_exit_status (struct thread* parent, tid_t child_tid) {
@@ -155,6 +214,9 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 
 	/* 1. TODO: If the parent_page is kernel page, then return immediately. */
     if(is_kern_pte(pte)) return true;
+    /* vDSO page는 복사하지 않고 __do_fork에서 새로 매핑한다. uring은 자식에게 물려주지 않는다. */
+    if(va == VDSO_DATA || va == VDSO_PROC) return true;
+    if(va >= (void *) URING_ADDR && va < (void *) URING_ADDR + URING_SIZE(URING_MAX_ENTRIES)) return true;
     
 
 	/* 2. Resolve VA from the parent's page map level 4. */
@@ -209,7 +271,7 @@ __do_fork (void **aux) {
 	/* Project2: System Calls */
 	if(parent->my_exec_file != NULL) {
         lock_acquire(&file_lock);
-        current->my_exec_file = file_duplicate(parent->my_exec_file);
+        current->my_exec_file = file_share(parent->my_exec_file);
         lock_release(&file_lock);
     }
 #ifdef VM
@@ -221,6 +283,8 @@ __do_fork (void **aux) {
 		goto error;
     }
 #endif
+	if (!vdso_map (current->pml4, current->tid))
+		goto error;
 
 	/* TODO: Your code goes here.
 	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
@@ -228,22 +292,10 @@ __do_fork (void **aux) {
 	 * TODO:       from the fork() until this function successfully duplicates
 	 * TODO:       the resources of parent.*/
 
-    
-    for(int i = 0; i < FDLIST_LEN; i++) {
-        struct file *p_f = (parent->fd_table)[i];
-        if(p_f == NULL) continue;
-
-        struct file *dup_f;
-        lock_acquire(&file_lock);
-        dup_f = file_duplicate(p_f);
-        lock_release(&file_lock);
-        if(dup_f == NULL) {
-            goto error;
-        }
-        (current->fd_table)[i] = dup_f;
+    if(!duplicate_fd_table(parent, current)) {
+        goto error;
     }
-    
-    
+
 
     process_init();
     
@@ -261,6 +313,125 @@ error:
 	thread_exit ();
 }
 
+/* PARENT의 fd table을 CHILD에 복제한다. 부모와 자식의 file 위치는 따로 움직이고,
+ * 부모에서 dup2로 공유하던 fd들은 자식에서도 서로 공유한다. 현재 디렉터리도 함께 물려준다. */
+static bool
+duplicate_fd_table (struct thread *parent, struct thread *child) {
+#ifdef FILESYS
+    if(parent->cwd != NULL) {
+        lock_acquire(&file_lock);
+        child->cwd = dir_reopen(parent->cwd);
+        lock_release(&file_lock);
+        if(child->cwd == NULL) {
+            return false;
+        }
+    }
+#endif
+    bool success;
+    lock_acquire(&file_lock);
+    success = fd_table_duplicate(parent, child);
+    lock_release(&file_lock);
+    return success;
+}
+
+/* process_spawn()으로 만든 자식의 시작 함수. 부모의 fd를 복제하고 info->cmd_line을 load한 뒤
+ * 결과를 부모에게 알리고 user mode로 넘어간다. */
+static void
+spawnd (void *info_) {
+    struct spawn_info *info = info_;
+    struct thread *current = thread_current ();
+    struct intr_frame _if;
+    bool success;
+
+#ifdef VM
+    supplemental_page_table_init (&current->spt);
+#endif
+    process_init ();
+
+    _if.ds = _if.es = _if.ss = SEL_UDSEG;
+    _if.cs = SEL_UCSEG;
+    _if.eflags = FLAG_IF | FLAG_MBS;
+
+    success = duplicate_fd_table (info->parent, current)
+              && load (info->cmd_line, &_if);
+
+    /* sema_up() 이후에는 부모 stack에 있는 info를 건드리면 안 된다. */
+    info->success = success;
+    sema_up (&info->loaded);
+
+    if (!success) {
+        current->exit_status = -1;
+        thread_exit ();
+    }
+    do_iret (&_if);
+    NOT_REACHED ();
+}
+
+/* process_vfork()로 만든 자식의 시작 함수. 부모의 pml4와 spt를 그대로 넘겨받아 실행한다.
+ * 자식은 부모의 stack 위에서 돌므로 exec이나 exit만 해야 한다. */
+static void
+__do_vfork (void *aux_) {
+	void **aux = aux_;
+	struct intr_frame if_;
+	struct thread *parent = (struct thread *)aux[0];
+	struct thread *current = thread_current ();
+	struct intr_frame *parent_if = (struct intr_frame *)aux[1];
+    struct semaphore *sema = (struct semaphore *)aux[2];
+    bool *success = (bool *)aux[3];
+
+	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+
+	/* 부모의 주소 공간을 빌린다. 부모는 sema에서 잠들어 있으므로 쓰지 않는다. */
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+	supplemental_page_table_move (&current->spt, &parent->spt);
+    current->stack_btm = parent->stack_btm;
+#endif
+	current->pml4 = parent->pml4;
+    parent->pml4 = NULL;
+    current->vfork_parent = parent;
+    current->vfork_sema = sema;
+    /* 빌린 vDSO page도 자식의 pid를 보여주도록 바꾼다. */
+    vdso_set_pid(current->pml4, current->tid);
+	process_activate (current);
+
+	if(parent->my_exec_file != NULL) {
+        lock_acquire(&file_lock);
+        current->my_exec_file = file_share(parent->my_exec_file);
+        lock_release(&file_lock);
+    }
+    if(!duplicate_fd_table(parent, current)) {
+        current->exit_status = -1;
+        thread_exit ();
+    }
+
+    process_init();
+
+    *success = true;
+    if_.R.rax = 0;
+    do_iret (&if_);
+    NOT_REACHED ();
+}
+
+/* vfork 자식 CHILD가 빌린 주소 공간을 부모에게 돌려주고 부모를 깨운다. */
+static void
+vfork_release (struct thread *child) {
+    struct thread *parent = child->vfork_parent;
+
+    if(parent == NULL) return;
+
+#ifdef VM
+    supplemental_page_table_move (&parent->spt, &child->spt);
+    parent->stack_btm = child->stack_btm;
+#endif
+    parent->pml4 = child->pml4;
+    child->pml4 = NULL;
+    vdso_set_pid(parent->pml4, parent->tid);
+    child->vfork_parent = NULL;
+    pml4_activate (NULL);
+    sema_up (child->vfork_sema);
+}
+
 struct child_list_elem *
 process_set_child_list(struct thread *parent, struct thread *child) {
     struct child_list_elem *child_elem = malloc(sizeof(struct child_list_elem));
@@ -381,9 +552,11 @@ process_exit (void) {
 
     /* fd table의 파일 닫기 */
     // lock_acquire(&file_lock);
-    for(int i = 0; i < FDLIST_LEN; i++) {
-        file_close(curr->fd_table[i]);
-    }
+    fd_table_destroy(curr);
+#ifdef FILESYS
+    dir_close(curr->cwd);
+    curr->cwd = NULL;
+#endif
 
 	if (flag) lock_release(&file_lock);
 
@@ -413,6 +586,12 @@ static void
 process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
+	/* A vfork child gives the borrowed address space back first. */
+	vfork_release (curr);
+
+	/* Let the ring's worker finish with our pages first. */
+	uring_destroy (curr);
+
 #ifdef VM
 	supplemental_page_table_kill (&curr->spt);
 #endif
@@ -431,6 +610,7 @@ process_cleanup (void) {
 		 * that's been freed (and cleared). */
 		curr->pml4 = NULL;
 		pml4_activate (NULL);
+		vdso_unmap (pml4);
 		pml4_destroy (pml4);
 	}
 }
@@ -499,7 +679,25 @@ struct ELF64_PHDR {
 #define ELF ELF64_hdr
 #define Phdr ELF64_PHDR
 
+/* One PT_LOAD segment, as load_segment() takes it. */
+struct exec_segment {
+	uint64_t file_page;         /* Page-aligned file offset. */
+	uint64_t mem_page;          /* Page-aligned user address. */
+	uint32_t read_bytes;        /* Bytes to read from the file. */
+	uint32_t zero_bytes;        /* Bytes to zero after them. */
+	bool writable;
+};
+
+/* What load() needs from an executable's headers, parsed and
+ * validated once and then cached on the file's inode. */
+struct exec_info {
+	uint64_t entry;             /* Entry point. */
+	int seg_cnt;                /* Number of SEGS. */
+	struct exec_segment segs[]; /* Loadable segments. */
+};
+
 // static bool setup_stack (struct intr_frame *if_);
+static struct exec_info *parse_exec_info (struct file *);
 static bool validate_segment (const struct Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
@@ -512,9 +710,8 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 load (const char *file_name, struct intr_frame *if_) {
 	struct thread *t = thread_current ();
-	struct ELF ehdr;
+	const struct exec_info *info;
 	struct file *file = NULL;
-	off_t file_ofs;
 	bool success = false;
 	int i;
 
@@ -552,91 +749,42 @@ load (const char *file_name, struct intr_frame *if_) {
 		goto done;
 	}
 
-	/* Read and verify executable header. */
+	/* Deny writes first: the cached header below stays valid only
+	 * while nobody can change the file. */
     lock_acquire(&file_lock);
-	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
-			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
-			|| ehdr.e_type != 2
-			|| ehdr.e_machine != 0x3E // amd64
-			|| ehdr.e_version != 1
-			|| ehdr.e_phentsize != sizeof (struct Phdr)
-			|| ehdr.e_phnum > 1024) {
+    file_deny_write(file);
+
+	/* Parse the ELF header and program headers, or reuse the result
+	 * of an earlier exec of the same binary. */
+    info = inode_get_exec_cache(file_get_inode(file));
+    if(info == NULL) {
+        info = parse_exec_info(file);
+        if(info != NULL) inode_set_exec_cache(file_get_inode(file), (void *) info);
+    }
+    lock_release(&file_lock);
+    if(info == NULL) {
 		printf ("load: %s: error loading executable\n", file_name);
 		goto done;
-	}
-    lock_release(&file_lock);
-
-	/* Read program headers. */
-	file_ofs = ehdr.e_phoff;
-	for (i = 0; i < ehdr.e_phnum; i++) {
-		struct Phdr phdr;
-        lock_acquire(&file_lock);
-		if (file_ofs < 0 || file_ofs > file_length (file)) {
-            lock_release(&file_lock);
-            goto done;
-        }
-        lock_release(&file_lock);
-
-		lock_acquire(&file_lock);
-		file_seek (file, file_ofs);
-        lock_release(&file_lock);
+    }
 
-        lock_acquire(&file_lock);
-		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr) {
-            lock_release(&file_lock);
-            goto done;
-        }
-        lock_release(&file_lock);
-			
-		file_ofs += sizeof phdr;
-		switch (phdr.p_type) {
-			case PT_NULL:
-			case PT_NOTE:
-			case PT_PHDR:
-			case PT_STACK:
-			default:
-				/* Ignore this segment. */
-				break;
-			case PT_DYNAMIC:
-			case PT_INTERP:
-			case PT_SHLIB:
-				goto done;
-			case PT_LOAD:
-				if (validate_segment (&phdr, file)) {
-					bool writable = (phdr.p_flags & PF_W) != 0;
-					uint64_t file_page = phdr.p_offset & ~PGMASK;
-					uint64_t mem_page = phdr.p_vaddr & ~PGMASK;
-					uint64_t page_offset = phdr.p_vaddr & PGMASK;
-					uint32_t read_bytes, zero_bytes;
-					if (phdr.p_filesz > 0) {
-						/* Normal segment.
-						 * Read initial part from disk and zero the rest. */
-						read_bytes = page_offset + phdr.p_filesz;
-						zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-								- read_bytes);
-					} else {
-						/* Entirely zero.
-						 * Don't read anything from disk. */
-						read_bytes = 0;
-						zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-					}
-					if (!load_segment (file, file_page, (void *) mem_page,
-								read_bytes, zero_bytes, writable))
-						goto done;
-				}
-				else
-					goto done;
-				break;
-		}
+	/* Install the loadable segments; pages are read on first fault. */
+	for (i = 0; i < info->seg_cnt; i++) {
+		const struct exec_segment *seg = &info->segs[i];
+		if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+					seg->read_bytes, seg->zero_bytes, seg->writable))
+			goto done;
 	}
 
-
 	/* Set up stack. */
 	if (!setup_stack (if_))
 		goto done;
 
+	/* Map the vDSO pages. */
+	if (!vdso_map (t->pml4, t->tid))
+		goto done;
+
 	/* Start address. */
-	if_->rip = ehdr.e_entry;
+	if_->rip = info->entry;
 
 
     /* PROJECT 2: ARGUMENT PASSING */
@@ -677,10 +825,6 @@ load (const char *file_name, struct intr_frame *if_) {
     if_->R.rdi = argc;
     if_->R.rsi = if_->rsp + PTR_SIZE;
 
-    lock_acquire(&file_lock);
-    file_deny_write(file);
-    lock_release(&file_lock);
-
     t->my_exec_file = file;
 	success = true;
     return success;
@@ -695,6 +839,87 @@ done:
 }
 
 
+/* Reads and validates FILE's ELF header and program headers, and
+ * returns the entry point and loadable segments in a block from
+ * malloc(), or NULL if FILE is not a loadable executable.
+ * The program headers are read with a single file_read_at().
+ * file_lock must be held. */
+static struct exec_info *
+parse_exec_info (struct file *file) {
+	struct ELF ehdr;
+	struct Phdr *phdrs = NULL;
+	struct exec_info *info = NULL;
+	size_t phdrs_size;
+	int i;
+
+	if (file_read_at (file, &ehdr, sizeof ehdr, 0) != sizeof ehdr
+			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
+			|| ehdr.e_type != 2
+			|| ehdr.e_machine != 0x3E // amd64
+			|| ehdr.e_version != 1
+			|| ehdr.e_phentsize != sizeof (struct Phdr)
+			|| ehdr.e_phnum > 1024
+			|| ehdr.e_phoff > (uint64_t) file_length (file))
+		return NULL;
+
+	phdrs_size = ehdr.e_phnum * sizeof *phdrs;
+	phdrs = malloc (phdrs_size + 1);
+	info = malloc (sizeof *info + ehdr.e_phnum * sizeof *info->segs);
+	if (phdrs == NULL || info == NULL
+			|| file_read_at (file, phdrs, phdrs_size, ehdr.e_phoff)
+				!= (off_t) phdrs_size)
+		goto error;
+
+	info->entry = ehdr.e_entry;
+	info->seg_cnt = 0;
+	for (i = 0; i < ehdr.e_phnum; i++) {
+		const struct Phdr *phdr = &phdrs[i];
+		switch (phdr->p_type) {
+			case PT_NULL:
+			case PT_NOTE:
+			case PT_PHDR:
+			case PT_STACK:
+			default:
+				/* Ignore this segment. */
+				break;
+			case PT_DYNAMIC:
+			case PT_INTERP:
+			case PT_SHLIB:
+				goto error;
+			case PT_LOAD:
+				if (validate_segment (phdr, file)) {
+					struct exec_segment *seg = &info->segs[info->seg_cnt++];
+					uint64_t page_offset = phdr->p_vaddr & PGMASK;
+					seg->writable = (phdr->p_flags & PF_W) != 0;
+					seg->file_page = phdr->p_offset & ~PGMASK;
+					seg->mem_page = phdr->p_vaddr & ~PGMASK;
+					if (phdr->p_filesz > 0) {
+						/* Normal segment.
+						 * Read initial part from disk and zero the rest. */
+						seg->read_bytes = page_offset + phdr->p_filesz;
+						seg->zero_bytes = (ROUND_UP (page_offset + phdr->p_memsz, PGSIZE)
+								- seg->read_bytes);
+					} else {
+						/* Entirely zero.
+						 * Don't read anything from disk. */
+						seg->read_bytes = 0;
+						seg->zero_bytes = ROUND_UP (page_offset + phdr->p_memsz, PGSIZE);
+					}
+				}
+				else
+					goto error;
+				break;
+		}
+	}
+	free (phdrs);
+	return info;
+
+error:
+	free (phdrs);
+	free (info);
+	return NULL;
+}
+
 /* Checks whether PHDR describes a valid, loadable segment in
  * FILE and returns true if so, false otherwise. */
 static bool
@@ -864,12 +1089,12 @@ lazy_load_segment (struct page *page, struct aux_data *aux) {
 	file_seek(file, ofs);
 
 	/* Load this page. */
-	if (file_read(file, page->va, page_read_bytes) != (int)page_read_bytes)
+	if (file_read(file, page->frame->kva, page_read_bytes) != (int)page_read_bytes)
 	{
 		return false;
 	}
 	
-	memset(page->va + page_read_bytes, 0, page_zero_bytes);
+	memset(page->frame->kva + page_read_bytes, 0, page_zero_bytes);
 	// free(aux);  
 	return true ;
 }
@@ -905,8 +1130,10 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 
 		/* TODO: Set up aux to pass information to the lazy_load_segment. */
 		struct aux_data *aux;
-        aux = (struct aux_data *)calloc(1, sizeof(struct aux_data));
-        
+        aux = (struct aux_data *)kmem_cache_alloc(aux_slab);
+        if (aux == NULL)
+            return false;
+
         aux->file = file;
         aux->page_read_bytes = page_read_bytes;
         aux->page_zero_bytes = page_zero_bytes;
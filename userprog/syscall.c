@@ -18,8 +18,19 @@
 #include "filesys/file.h"
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
+#include "threads/malloc.h"
 #include "vm/file.h"
 #include "threads/mmu.h"
+#include "userprog/exception.h"
+#include <bitmap.h>
+#include <iovec.h>
+#include <vdso.h>
+#include <uring.h>
+#include "userprog/uring.h"
+#include "filesys/journal.h"
+#include "filesys/inode.h"
+#include "filesys/directory.h"
+#include <limits.h>
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
@@ -48,11 +59,19 @@ void syscall_handler (struct intr_frame *);
 #define F_ARG6 f->R.r9
 
 bool address_check(bool write, char *ptr);
+static int user_file_io(struct intr_frame *f, struct file *file, const struct iovec *iov,
+                        int iovcnt, off_t *ofs, bool write);
+static int user_console_write(struct intr_frame *f, const struct iovec *iov, int iovcnt);
+static struct iovec *iovec_copy_in(struct intr_frame *f, const struct iovec *uiov, int iovcnt);
+static struct file *fd_entry(struct thread *t, int fd);
+
+/* fd table에서 콘솔을 나타내는 값. 진짜 struct file이 아니므로 file 함수에 넘기지 않는다.
+ * fd 0은 처음에 CONSOLE_IN, 1과 2는 CONSOLE_OUT이고 dup2로 옮기거나 닫을 수 있다. */
+#define CONSOLE_IN ((struct file *) 1)
+#define CONSOLE_OUT ((struct file *) 2)
+#define is_console(FILE) ((FILE) == CONSOLE_IN || (FILE) == CONSOLE_OUT)
 
 int fd_table_get_fd(struct file *_file);
-struct file *fd_table_get_file(int fd);
-int fd_table_insert(struct file *_file);
-void fd_table_remove(int fd);
 
 struct system_call syscall_list[] = {
         {SYS_HALT, halt_handler}, 
@@ -79,7 +98,18 @@ struct system_call syscall_list[] = {
         {SYS_SYMLINK, symlink_handler},
         {SYS_DUP2, dup2_handler},
         {SYS_MOUNT, mount_handler},
-        {SYS_UMOUNT, umount_handler}
+        {SYS_UMOUNT, umount_handler},
+        {SYS_PREAD, pread_handler},
+        {SYS_PWRITE, pwrite_handler},
+        {SYS_READV, readv_handler},
+        {SYS_WRITEV, writev_handler},
+        {SYS_COPY_FILE_RANGE, copy_file_range_handler},
+        {SYS_URING_SETUP, uring_setup_handler},
+        {SYS_URING_ENTER, uring_enter_handler},
+        {SYS_SPAWN, spawn_handler},
+        {SYS_VFORK, vfork_handler},
+        {SYS_FSYNC, fsync_handler},
+        {SYS_FALLOCATE, fallocate_handler}
     };
 
 
@@ -212,21 +242,15 @@ void read_handler(struct intr_frame *f) {
     void *buffer = (void *)F_ARG2;
     unsigned size = F_ARG3;
 
-    if(fd < 0 || FDLIST_LEN <= fd) kern_exit(f, -1);
-    if(fd == 1) kern_exit(f, -1);
-    if (!address_check (true, buffer)) kern_exit (f, -1);
-    // if (!spt_find_page (&thread_current ()->spt, buffer)->writable) kern_exit (f, -1);//? 너냐?
-    // if(!address_check(true, buffer)) kern_exit(f, -1);
-    // if(!address_check(true, buffer+size-1)) kern_exit(f, -1);
+    if(fd < 0) kern_exit(f, -1);
 
-    struct file *file_ = fd_table_get_file(fd);
-    if(file_ == NULL) return;
+    struct file *file_ = fd_entry(thread_current(), fd);
+    if(file_ == CONSOLE_OUT) kern_exit(f, -1);
+    if(file_ == NULL || file_ == CONSOLE_IN) return;
 
-    lock_acquire(&file_lock);
-    size = file_read(file_, buffer, size);
-    lock_release(&file_lock);
-    
-    F_RAX = size;
+    /* buffer 검사는 copy_to_user가 복사하면서 한다. */
+    struct iovec iov = { buffer, size < INT_MAX ? size : INT_MAX };
+    F_RAX = user_file_io(f, file_, &iov, 1, NULL, false);
 }
 
 void write_handler(struct intr_frame *f) {
@@ -234,30 +258,15 @@ void write_handler(struct intr_frame *f) {
     char *buffer = (char *)F_ARG2;
     unsigned size = F_ARG3;
 
-    if(fd <= 0) return;
-
-    if(!address_check(false, buffer)) kern_exit(f, -1);
-    if(!address_check(false, buffer+size-1)) kern_exit(f, -1);
+    struct file *file_ = fd_entry(thread_current(), fd);
+    if(file_ == NULL || file_ == CONSOLE_IN) return;
 
-    if(fd == 1) {
-        if(size > 0) {
-            if(strlen(buffer) > size) {
-                char new_buf[size];
-                strlcpy(new_buf, buffer, size);
-                printf("%s", new_buf);
-            } else {
-                printf("%s", buffer);
-            }
-        } else {
-            size = 0;
-        }
+    struct iovec iov = { buffer, size < INT_MAX ? size : INT_MAX };
+    if(file_ == CONSOLE_OUT) {
+        /* 콘솔 출력은 길이만큼 putbuf로 한 번에 보낸다. NUL이 있어도 그대로 출력된다. */
+        size = user_console_write(f, &iov, 1);
     } else {
-        struct file *file_ = fd_table_get_file(fd);
-        if(file_ == NULL) return;
-        
-        lock_acquire(&file_lock);
-        size = file_write(file_, buffer, size);
-        lock_release(&file_lock);
+        size = user_file_io(f, file_, &iov, 1, NULL, true);
     }
     
     F_RAX = size;
@@ -268,8 +277,9 @@ void seek_handler(struct intr_frame *f) {
     unsigned position = (unsigned)F_ARG2;
     struct file *getfile = NULL;
 
+    /* 닫힌 fd나 콘솔의 seek는 아무것도 하지 않는다. */
     getfile = fd_table_get_file(fd);
-    if(getfile == NULL) kern_exit(f, -1);
+    if(getfile == NULL) return;
 
     lock_acquire(&file_lock);
     file_seek(getfile, position);
@@ -279,21 +289,25 @@ void seek_handler(struct intr_frame *f) {
 void tell_handler(struct intr_frame *f) {
     int fd = F_ARG1;
     struct file *tell_file = fd_table_get_file(fd);
-    if(tell_file == NULL) kern_exit(f, -1);
+    F_RAX = -1;
+    if(tell_file == NULL) return;
 
     lock_acquire(&file_lock);
     F_RAX = file_tell(tell_file);
     lock_release(&file_lock);
 }
 
+/* fd를 닫는다. 다른 fd나 프로세스가 같은 파일을 공유하고 있으면 참조 수만 줄인다. */
 void close_handler(struct intr_frame *f) {
     int fd = F_ARG1;
-    struct file *file_ = fd_table_get_file(fd);
+    struct file *file_ = fd_entry(thread_current(), fd);
     if(file_ == NULL) return;
 
-    lock_acquire(&file_lock);
-    file_close(file_);
-    lock_release(&file_lock);
+    if(!is_console(file_)) {
+        lock_acquire(&file_lock);
+        file_close(file_);
+        lock_release(&file_lock);
+    }
 
     fd_table_remove(fd);
 }
@@ -318,6 +332,7 @@ void mmap_handler(struct intr_frame *f) {
         || length >= 0x8004000000  //? what is it? 
         || file_length (fd_table_get_file(fd)) <= 0
         || spt_find_page (spt, pg_round_down(addr))
+        || (addr < (void *) URING_ADDR + URING_SIZE(URING_MAX_ENTRIES) && addr + length > (void *) VDSO_DATA)
     ) {
         /* mmap validity check failed. */
         F_RAX = NULL;
@@ -349,6 +364,9 @@ void mnumap_handler(struct intr_frame *f) {
 		|| (page_cnt = page->page_cnt) == 0)
 		return;
 
+	/* uring worker가 이 page들에 I/O 중일 수 있으므로 page를 내리기 전에 끝날 때까지 기다린다. */
+	uring_quiesce (thread_current ());
+
 	lock_acquire (&spt->spt_lock);
 
 	do_munmap (addr);
@@ -373,40 +391,347 @@ void mnumap_handler(struct intr_frame *f) {
 	lock_release (&spt->spt_lock);
 }
 
+/* 현재 디렉터리를 dir로 바꾼다. 상대 경로는 이 디렉터리에서부터 찾는다. */
 void chdir_handler(struct intr_frame *f) {
+    const char *dir = (const char *)F_ARG1;
+
+    if(dir == NULL) kern_exit(f, -1);
+    if(!address_check(false, (char *)dir)) kern_exit(f, -1);
 
+    lock_acquire(&file_lock);
+    F_RAX = filesys_chdir(dir);
+    lock_release(&file_lock);
 }
 
 void mkdir_handler(struct intr_frame *f) {
+    const char *dir = (const char *)F_ARG1;
 
+    if(dir == NULL) kern_exit(f, -1);
+    if(!address_check(false, (char *)dir)) kern_exit(f, -1);
+
+    lock_acquire(&file_lock);
+    F_RAX = filesys_mkdir(dir);
+    lock_release(&file_lock);
 }
 
+/* 디렉터리 fd에서 다음 항목의 이름을 name에 넣는다. "."과 ".."은 건너뛴다.
+ * 읽은 위치는 file의 pos에 남겨 다음 readdir이 이어서 읽는다.
+ * name은 copy_to_user가 복사하면서 검사한다. */
 void readdir_handler(struct intr_frame *f) {
-    
+    int fd = F_ARG1;
+    char *name = (char *)F_ARG2;
+    char entry[NAME_MAX + 1];
+    struct file *file = fd_table_get_file(fd);
+    struct dir *dir;
+
+    F_RAX = false;
+    if(file == NULL) return;
+    if(!inode_is_dir(file_get_inode(file))) return;
+
+    lock_acquire(&file_lock);
+    dir = dir_open(inode_reopen(file_get_inode(file)));
+    if(dir != NULL) {
+        dir_seek(dir, file_tell(file));
+        F_RAX = dir_readdir(dir, entry);
+        file_seek(file, dir_tell(dir));
+        dir_close(dir);
+    }
+    lock_release(&file_lock);
+
+    if(F_RAX && !copy_to_user(name, entry, strlen(entry) + 1)) kern_exit(f, -1);
 }
 
 void isdir_handler(struct intr_frame *f) {
-    
+    int fd = F_ARG1;
+    struct file *file = fd_table_get_file(fd);
+
+    F_RAX = file != NULL && inode_is_dir(file_get_inode(file));
 }
 
+/* fd가 가리키는 파일의 inode 번호(inode가 있는 섹터)를 돌려준다. */
 void inumber_handler(struct intr_frame *f) {
-    
+    int fd = F_ARG1;
+    struct file *file = fd_table_get_file(fd);
+    if(file == NULL) kern_exit(f, -1);
+
+    F_RAX = inode_get_inumber(file_get_inode(file));
 }
 
+/* target을 가리키는 심볼릭 링크 linkpath를 만든다. target은 없어도 된다.
+ * 성공하면 0, 실패하면 -1. */
 void symlink_handler(struct intr_frame *f) {
-    
+    const char *target = (const char *)F_ARG1;
+    const char *linkpath = (const char *)F_ARG2;
+
+    if(target == NULL || linkpath == NULL) kern_exit(f, -1);
+    if(!address_check(false, (char *)target)) kern_exit(f, -1);
+    if(!address_check(false, (char *)linkpath)) kern_exit(f, -1);
+
+    lock_acquire(&file_lock);
+    F_RAX = filesys_symlink(target, linkpath) ? 0 : -1;
+    lock_release(&file_lock);
 }
 
+/* oldfd가 가리키는 파일을 newfd도 가리키게 한다. 새로 열지 않고 같은 struct file을 공유하므로
+ * 두 fd는 file 위치를 함께 쓴다. newfd가 열려 있었으면 닫는다. 콘솔 fd도 옮길 수 있어서
+ * dup2(fd, 1)로 표준 출력을 파일로 돌릴 수 있다. 성공하면 newfd, 실패하면 -1. */
 void dup2_handler(struct intr_frame *f) {
-    
+    int oldfd = F_ARG1;
+    int newfd = F_ARG2;
+    struct thread *curr = thread_current();
+    struct file *file = fd_entry(curr, oldfd);
+
+    F_RAX = -1;
+    if(file == NULL || newfd < 0 || newfd >= FD_MAX) return;
+    if(oldfd == newfd) {
+        F_RAX = newfd;
+        return;
+    }
+
+    lock_acquire(&file_lock);
+    struct file *prev = fd_entry(curr, newfd);
+    if(fd_table_install(curr, newfd, file)) {
+        if(!is_console(file)) file_share(file);
+        if(prev != NULL && !is_console(prev)) file_close(prev);
+        F_RAX = newfd;
+    }
+    lock_release(&file_lock);
 }
 
+/* chan_no:dev_no 디스크의 파일 시스템을 path 위에 mount한다.
+ * 포맷되지 않은 디스크는 먼저 포맷한다. 성공하면 0, 실패하면 -1. */
 void mount_handler(struct intr_frame *f) {
-    
+    const char *path = (const char *)F_ARG1;
+    int chan_no = F_ARG2;
+    int dev_no = F_ARG3;
+
+    if(path == NULL) kern_exit(f, -1);
+    if(!address_check(false, (char *)path)) kern_exit(f, -1);
+
+    lock_acquire(&file_lock);
+    F_RAX = filesys_mount(path, chan_no, dev_no);
+    lock_release(&file_lock);
 }
 
+/* path에 mount된 파일 시스템을 내린다.
+ * 그 안에 열린 파일이 남아 있으면 실패(-1)한다. */
 void umount_handler(struct intr_frame *f) {
-    
+    const char *path = (const char *)F_ARG1;
+
+    if(path == NULL) kern_exit(f, -1);
+    if(!address_check(false, (char *)path)) kern_exit(f, -1);
+
+    lock_acquire(&file_lock);
+    F_RAX = filesys_umount(path);
+    lock_release(&file_lock);
+}
+
+/* fd의 offset 위치부터 읽는다. file의 현재 위치(pos)는 바뀌지 않는다. */
+void pread_handler(struct intr_frame *f) {
+    int fd = F_ARG1;
+    void *buffer = (void *)F_ARG2;
+    unsigned size = F_ARG3;
+    off_t offset = F_ARG4;
+
+    F_RAX = -1;
+    if(fd < 0 || fd_entry(thread_current(), fd) == CONSOLE_OUT) kern_exit(f, -1);
+    if(offset < 0) return;
+
+    struct file *file_ = fd_table_get_file(fd);
+    if(file_ == NULL) return;
+
+    struct iovec iov = { buffer, size < INT_MAX ? size : INT_MAX };
+    F_RAX = user_file_io(f, file_, &iov, 1, &offset, false);
+}
+
+/* fd의 offset 위치에 쓴다. file의 현재 위치(pos)는 바뀌지 않는다. */
+void pwrite_handler(struct intr_frame *f) {
+    int fd = F_ARG1;
+    void *buffer = (void *)F_ARG2;
+    unsigned size = F_ARG3;
+    off_t offset = F_ARG4;
+
+    F_RAX = -1;
+    if(fd <= 0) return;
+    if(offset < 0) return;
+
+    struct file *file_ = fd_table_get_file(fd);
+    if(file_ == NULL) return;
+
+    struct iovec iov = { buffer, size < INT_MAX ? size : INT_MAX };
+    F_RAX = user_file_io(f, file_, &iov, 1, &offset, true);
+}
+
+/* iov의 buffer들을 차례로 채운다. 모든 buffer를 한 번의 file_lock 안에서 읽으므로
+ * 중간에 다른 프로세스의 읽기/쓰기가 끼어들지 않는다. */
+void readv_handler(struct intr_frame *f) {
+    int fd = F_ARG1;
+    const struct iovec *uiov = (const struct iovec *)F_ARG2;
+    int iovcnt = F_ARG3;
+    struct iovec *iov;
+
+    F_RAX = -1;
+    if(fd < 0 || fd_entry(thread_current(), fd) == CONSOLE_OUT) kern_exit(f, -1);
+
+    struct file *file_ = fd_table_get_file(fd);
+    if(file_ == NULL) return;
+    if((iov = iovec_copy_in(f, uiov, iovcnt)) == NULL) return;
+
+    F_RAX = user_file_io(f, file_, iov, iovcnt, NULL, false);
+    free(iov);
+}
+
+/* iov의 buffer들을 차례로 쓴다. 콘솔(처음에는 fd 1)은 buffer마다 putbuf로 길이만큼만 출력한다. */
+void writev_handler(struct intr_frame *f) {
+    int fd = F_ARG1;
+    const struct iovec *uiov = (const struct iovec *)F_ARG2;
+    int iovcnt = F_ARG3;
+    struct file *file_ = fd_entry(thread_current(), fd);
+    struct iovec *iov;
+
+    F_RAX = -1;
+    if(file_ == NULL || file_ == CONSOLE_IN) return;
+    if((iov = iovec_copy_in(f, uiov, iovcnt)) == NULL) return;
+
+    if(file_ == CONSOLE_OUT)
+        F_RAX = user_console_write(f, iov, iovcnt);
+    else
+        F_RAX = user_file_io(f, file_, iov, iovcnt, NULL, true);
+    free(iov);
+}
+
+
+/* fd_in의 데이터를 kernel buffer를 거쳐 fd_out으로 복사한다. user buffer를 거치지 않으므로
+ * read/write를 반복하는 것보다 복사와 syscall 횟수가 줄어든다.
+ * off_in/off_out이 NULL이면 file의 현재 위치를 쓰고 옮기며, 아니면 그 offset을 쓰고 갱신한다. */
+void copy_file_range_handler(struct intr_frame *f) {
+    int fd_in = F_ARG1;
+    off_t *off_in = (off_t *)F_ARG2;
+    int fd_out = F_ARG3;
+    off_t *off_out = (off_t *)F_ARG4;
+    unsigned length = F_ARG5;
+    off_t ofs_in, ofs_out;
+
+    F_RAX = -1;
+    if(off_in != NULL && !copy_from_user(&ofs_in, off_in, sizeof ofs_in)) kern_exit(f, -1);
+    if(off_out != NULL && !copy_from_user(&ofs_out, off_out, sizeof ofs_out)) kern_exit(f, -1);
+
+    struct file *in = fd_table_get_file(fd_in);
+    struct file *out = fd_table_get_file(fd_out);
+    if(in == NULL || out == NULL) return;
+    if(length > INT_MAX) length = INT_MAX;
+
+    lock_acquire(&file_lock);
+    if(off_in == NULL) ofs_in = file_tell(in);
+    if(off_out == NULL) ofs_out = file_tell(out);
+
+    /* 같은 파일 안에서 겹치는 구간끼리는 복사하지 않는다. */
+    if(ofs_in < 0 || ofs_out < 0
+        || (file_get_inode(in) == file_get_inode(out)
+            && ofs_in < (int64_t) ofs_out + length && ofs_out < (int64_t) ofs_in + length)) {
+        lock_release(&file_lock);
+        return;
+    }
+
+    F_RAX = file_copy_range(in, &ofs_in, out, &ofs_out, length);
+    if(off_in == NULL) file_seek(in, ofs_in);
+    if(off_out == NULL) file_seek(out, ofs_out);
+    lock_release(&file_lock);
+
+    if(off_in != NULL && !copy_to_user(off_in, &ofs_in, sizeof ofs_in)) kern_exit(f, -1);
+    if(off_out != NULL && !copy_to_user(off_out, &ofs_out, sizeof ofs_out)) kern_exit(f, -1);
+}
+
+
+/* 프로세스의 submission/completion ring을 만들고 user 주소를 돌려준다. */
+void uring_setup_handler(struct intr_frame *f) {
+    unsigned entries = F_ARG1;
+    F_RAX = (uint64_t) uring_setup(entries);
+}
+
+/* ring에 쌓인 요청을 최대 to_submit개 제출하고, 완료가 min_complete개 쌓일 때까지 기다린다.
+ * 한 번의 trap으로 여러 read/write/open/close를 처리할 수 있다. */
+void uring_enter_handler(struct intr_frame *f) {
+    unsigned to_submit = F_ARG1;
+    unsigned min_complete = F_ARG2;
+    F_RAX = uring_enter(to_submit, min_complete);
+}
+
+/* path의 프로그램을 argv[1..]을 인자로 새 프로세스에서 실행한다. fork + exec와 달리 부모의 주소 공간을 복사하지 않는다. */
+void spawn_handler(struct intr_frame *f) {
+    const char *path = (const char *)F_ARG1;
+    char **argv = (char **)F_ARG2;
+    char *cmd_line = palloc_get_page(0);
+    int len;
+
+    F_RAX = -1;
+    if(cmd_line == NULL) return;
+    if((len = copy_str_from_user(cmd_line, path, PGSIZE)) < 0) {
+        palloc_free_page(cmd_line);
+        kern_exit(f, -1);
+    }
+    /* 빈 경로는 잘못된 포인터가 아니므로 실패만 돌려준다. */
+    if(len == 0) {
+        palloc_free_page(cmd_line);
+        return;
+    }
+
+    /* argv[0]은 프로그램 이름이므로 argv[1]부터 공백으로 이어 붙여 load가 받는 명령줄을 만든다. */
+    for(int i = 1; argv != NULL; i++) {
+        char *arg;
+        int n;
+
+        if(!copy_from_user(&arg, argv + i, sizeof arg)) {
+            palloc_free_page(cmd_line);
+            kern_exit(f, -1);
+        }
+        if(arg == NULL) break;
+        if(len + 1 >= PGSIZE || (n = copy_str_from_user(cmd_line + len + 1, arg, PGSIZE - len - 1)) < 0) {
+            palloc_free_page(cmd_line);
+            return;
+        }
+        cmd_line[len] = ' ';
+        len += n + 1;
+    }
+
+    F_RAX = process_spawn(cmd_line);
+}
+
+/* 부모의 주소 공간을 빌려 쓰는 자식을 만든다. 자식이 exec하거나 종료할 때까지 부모는 돌아오지 않는다. */
+void vfork_handler(struct intr_frame *f) {
+    F_RAX = process_vfork(thread_name(), f);
+}
+
+/* fsync: fd가 가리키는 파일의 메타데이터를 디스크에 확정한다.
+ * 파일 데이터는 원래 바로 디스크에 쓰이니, 저널을 커밋하면 끝.
+ * 동시에 들어온 fsync들은 커밋 한 번을 같이 기다린다 (group commit). */
+void fsync_handler(struct intr_frame *f) {
+    int fd = F_ARG1;
+    struct file *file = fd_table_get_file(fd);
+    if(file == NULL) kern_exit(f, -1);
+
+    journal_sync(inode_get_fs(file_get_inode(file)));
+    F_RAX = 0;
+}
+
+/* fallocate: [offset, offset + len) 구간의 섹터를 미리 잡아둔다.
+ * 0으로 채우지 않고 파일 길이도 그대로 (Linux의 FALLOC_FL_KEEP_SIZE).
+ * 이후 그 구간에 쓰는 write는 할당 없이 연속된 섹터에 들어간다. */
+void fallocate_handler(struct intr_frame *f) {
+    int fd = F_ARG1;
+    off_t offset = F_ARG2;
+    off_t len = F_ARG3;
+    struct file *file = fd_table_get_file(fd);
+    if(file == NULL) kern_exit(f, -1);
+
+    if(offset < 0 || len <= 0 || offset > INT_MAX - len) {
+        F_RAX = -1;
+        return;
+    }
+
+    lock_acquire(&file_lock);
+    F_RAX = file_allocate(file, offset, len) ? 0 : -1;
+    lock_release(&file_lock);
 }
 
 
@@ -428,6 +753,114 @@ address_check(bool write, char *ptr) {
     return true;
 }
 
+/* file과 user buffer들(iov) 사이에서 데이터를 옮긴다. write가 true면 user -> file, 아니면 file -> user.
+ * ofs가 NULL이면 file의 현재 위치를 쓰고 옮기며, 아니면 *ofs 위치부터 읽고 쓴다(pread/pwrite).
+ * 데이터는 kernel page 하나를 bounce buffer로 거쳐 copy_from_user/copy_to_user로 복사되므로
+ * user buffer를 page마다 spt에서 미리 찾아볼 필요가 없다. 잘못된 user 주소를 만나면 프로세스를 종료한다.
+ * iov의 전체 길이는 INT_MAX를 넘지 않아야 한다. 디렉터리는 읽고 쓸 수 없다(-1). */
+static int
+user_file_io(struct intr_frame *f, struct file *file, const struct iovec *iov,
+             int iovcnt, off_t *ofs, bool write) {
+    uint8_t *bounce;
+    bool fault = false, done = false;
+    int total = 0;
+    off_t pos;
+
+    if(inode_is_dir(file_get_inode(file))) return -1;
+    bounce = palloc_get_page(0);
+    if(bounce == NULL) return -1;
+
+    lock_acquire(&file_lock);
+    pos = ofs != NULL ? *ofs : file_tell(file);
+    for(int i = 0; i < iovcnt && !done; i++) {
+        uint8_t *ubuf = iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+
+        while(left > 0) {
+            off_t chunk = left < PGSIZE ? left : PGSIZE;
+            off_t n;
+
+            /* 복사하는 동안 user page가 evict되어 file_lock을 잡은 채 다시 fault나지 않도록 고정한다. */
+            vm_pin_range(ubuf, chunk);
+            if(write) {
+                if(!copy_from_user(bounce, ubuf, chunk)) fault = true;
+                else n = file_write_at(file, bounce, chunk, pos);
+            } else {
+                n = file_read_at(file, bounce, chunk, pos);
+                if(!copy_to_user(ubuf, bounce, n)) fault = true;
+            }
+            vm_unpin_range(ubuf, chunk);
+            if(fault) break;
+
+            pos += n;
+            total += n;
+            ubuf += n;
+            left -= n;
+            if(n < chunk) break;  /* 파일 끝 */
+        }
+        done = fault || left > 0;
+    }
+    if(ofs == NULL) file_seek(file, pos);
+    lock_release(&file_lock);
+
+    palloc_free_page(bounce);
+    if(fault) kern_exit(f, -1);
+    return total;
+}
+
+/* user buffer들(iov)을 콘솔에 길이만큼 출력한다. 잘못된 user 주소를 만나면 프로세스를 종료한다. */
+static int
+user_console_write(struct intr_frame *f, const struct iovec *iov, int iovcnt) {
+    uint8_t *bounce = palloc_get_page(0);
+    int total = 0;
+
+    if(bounce == NULL) return -1;
+
+    for(int i = 0; i < iovcnt; i++) {
+        const uint8_t *ubuf = iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+
+        while(left > 0) {
+            size_t chunk = left < PGSIZE ? left : PGSIZE;
+            if(!copy_from_user(bounce, ubuf, chunk)) {
+                palloc_free_page(bounce);
+                kern_exit(f, -1);
+            }
+            putbuf((const char *) bounce, chunk);
+            total += chunk;
+            ubuf += chunk;
+            left -= chunk;
+        }
+    }
+    palloc_free_page(bounce);
+    return total;
+}
+
+/* user의 iov 배열을 kernel로 복사해 돌려준다. 호출자가 free()한다.
+ * iovcnt나 전체 길이가 범위를 벗어나면 NULL을 돌려주고, iov 배열이 잘못된 주소면 프로세스를 종료한다. */
+static struct iovec *
+iovec_copy_in(struct intr_frame *f, const struct iovec *uiov, int iovcnt) {
+    struct iovec *iov;
+    size_t total = 0;
+
+    if(iovcnt < 0 || iovcnt > IOV_MAX) return NULL;
+    iov = malloc(iovcnt * sizeof *iov + 1);  /* iovcnt가 0이어도 NULL이 아니도록 */
+    if(iov == NULL) return NULL;
+    if(!copy_from_user(iov, uiov, iovcnt * sizeof *iov)) {
+        free(iov);
+        kern_exit(f, -1);
+    }
+
+    for(int i = 0; i < iovcnt; i++) {
+        if(iov[i].iov_len > INT_MAX - total) {
+            free(iov);
+            return NULL;
+        }
+        total += iov[i].iov_len;
+    }
+    return iov;
+}
+
 void 
 kern_exit(struct intr_frame *f, int status) {
     F_ARG1 = status;
@@ -436,11 +869,64 @@ kern_exit(struct intr_frame *f, int status) {
 }
 
 
+/* fd table는 page 단위로 할당되는 배열과 사용 중인 slot을 표시하는 bitmap으로 구성된다.
+ * 처음 fd를 할당할 때 한 page 크기로 만들고, 가득 차면 FD_MAX까지 두 배씩 늘린다.
+ * 한 struct file을 여러 fd(dup2)나 여러 프로세스(fork)가 참조 수를 늘려 함께 쓴다. */
+#define FD_PAGE_SLOTS ((int) (PGSIZE / sizeof (struct file *)))
+
+/* T의 fd 자리에 있는 값을 돌려준다. 콘솔 표시일 수도 있다.
+ * table이 아직 없으면 0, 1, 2는 처음 상태(콘솔)다. */
+static struct file *
+fd_entry(struct thread *t, int fd) {
+    if(fd < 0) return NULL;
+    if(t->fd_cap == 0) return fd == 0 ? CONSOLE_IN : fd < FD_MIN ? CONSOLE_OUT : NULL;
+    if(fd >= t->fd_cap) return NULL;
+    return t->fd_table[fd];
+}
+
+/* T의 fd table을 최소 CAP개의 slot을 갖도록 키운다. */
+static bool
+fd_table_grow(struct thread *t, int cap) {
+    int new_cap = t->fd_cap == 0 ? FD_PAGE_SLOTS : t->fd_cap;
+    while(new_cap < cap) new_cap *= 2;
+    if(new_cap > FD_MAX) return false;
+    if(new_cap == t->fd_cap) return true;
+
+    size_t page_cnt = new_cap / FD_PAGE_SLOTS;
+    struct file **files = palloc_get_multiple(PAL_ZERO, page_cnt);
+    struct bitmap *map = bitmap_create(new_cap);
+    if(files == NULL || map == NULL) {
+        palloc_free_multiple(files, page_cnt);
+        bitmap_destroy(map);
+        return false;
+    }
+
+    /* 0, 1, 2는 stdin, stdout, stderr용으로 open()이 내주지 않는다. */
+    bitmap_set_multiple(map, 0, FD_MIN, true);
+    if(t->fd_cap == 0) {
+        files[0] = CONSOLE_IN;
+        files[1] = files[2] = CONSOLE_OUT;
+    }
+    for(int i = 0; i < t->fd_cap; i++) {
+        files[i] = t->fd_table[i];
+        if(files[i] != NULL) bitmap_mark(map, i);
+    }
+
+    if(t->fd_table != NULL)
+        palloc_free_multiple(t->fd_table, t->fd_cap / FD_PAGE_SLOTS);
+    bitmap_destroy(t->fd_map);
+    t->fd_table = files;
+    t->fd_map = map;
+    t->fd_cap = new_cap;
+    return true;
+}
+
 int
 fd_table_get_fd(struct file *_file) {
-    for(int i = 3; i < FDLIST_LEN; i++) {
-        if((thread_current()->fd_table)[i] == NULL) continue;
-        if((thread_current()->fd_table)[i] == _file) {
+    struct thread *curr = thread_current();
+    for(int i = FD_MIN; i < curr->fd_cap; i++) {
+        if((curr->fd_table)[i] == NULL) continue;
+        if((curr->fd_table)[i] == _file) {
             return i;
         }
     }
@@ -448,27 +934,132 @@ fd_table_get_fd(struct file *_file) {
 }
 
 
+/* 비어 있는 가장 작은 fd에 _file을 넣는다. bitmap에서 word 단위로 찾으므로 fd가 많아도 빠르다. */
 int
 fd_table_insert(struct file *_file) {
-    for(int i = 3; i < FDLIST_LEN; i++) {
-        if((thread_current()->fd_table)[i] == NULL) {
-            (thread_current()->fd_table)[i] = _file;
-            return i;
-        }
+    struct thread *curr = thread_current();
+    size_t fd = BITMAP_ERROR;
+
+    if(curr->fd_map != NULL)
+        fd = bitmap_scan_and_flip(curr->fd_map, FD_MIN, 1, false);
+    if(fd == BITMAP_ERROR) {
+        if(!fd_table_grow(curr, curr->fd_cap + 1)) return -1;
+        fd = bitmap_scan_and_flip(curr->fd_map, FD_MIN, 1, false);
     }
-    return -1;
+    (curr->fd_table)[fd] = _file;
+    return fd;
+}
+
+
+/* T의 fd table의 FD 자리에 _file을 넣는다. 필요하면 table을 키운다. (dup2용)
+ * FD에 있던 파일은 닫지 않는다. */
+bool
+fd_table_install(struct thread *t, int fd, struct file *_file) {
+    if(fd < 0 || fd >= FD_MAX) return false;
+    if(fd >= t->fd_cap && !fd_table_grow(t, fd + 1)) return false;
+    (t->fd_table)[fd] = _file;
+    bitmap_mark(t->fd_map, fd);
+    return true;
 }
 
 
+/* fd를 비운다. 파일은 닫지 않는다. 콘솔 fd(0, 1, 2)도 비울 수 있다. */
 void
 fd_table_remove(int fd) {
-    if(fd < 3 || fd >= FDLIST_LEN) return;
-    (thread_current()->fd_table)[fd] = NULL;
+    struct thread *curr = thread_current();
+    if(fd < 0) return;
+    if(curr->fd_cap == 0 && fd < FD_MIN && !fd_table_grow(curr, FD_MIN)) return;
+    if(fd >= curr->fd_cap) return;
+    (curr->fd_table)[fd] = NULL;
+    if(fd >= FD_MIN) bitmap_reset(curr->fd_map, fd);
 }
 
 
+/* fd가 가리키는 파일. 열려 있지 않거나 콘솔이면 NULL. */
 struct file *
 fd_table_get_file(int fd) {
-    if(fd < 3 || fd >= FDLIST_LEN) return NULL;
-    return (thread_current()->fd_table)[fd];
+    struct file *file = fd_entry(thread_current(), fd);
+    return is_console(file) ? NULL : file;
+}
+
+
+/* fd_table_duplicate에서 부모의 공유 파일과 그 자식 쪽 복제본을 짝지어 두는 slot. */
+struct fd_copy {
+    struct file *file;                  /* 부모의 파일. 빈 slot이면 NULL. */
+    struct file *copy;                  /* 자식에게 준 복제본. */
+};
+
+
+/* COPIES(slot CAP개, CAP은 2의 거듭제곱)에서 FILE의 slot을 찾는다.
+ * 없으면 FILE을 넣을 빈 slot을 돌려준다. */
+static struct fd_copy *
+fd_copy_slot(struct fd_copy *copies, size_t cap, struct file *file) {
+    size_t idx = (size_t) (((uint64_t) file * 0x9e3779b97f4a7c15ULL) >> 32) & (cap - 1);
+    while(copies[idx].file != NULL && copies[idx].file != file)
+        idx = (idx + 1) & (cap - 1);
+    return &copies[idx];
+}
+
+
+/* PARENT의 fd table을 CHILD에 복제한다. 파일마다 file_duplicate()로 새 struct file을 만들어
+ * 부모와 자식의 file 위치는 따로 움직인다 (Pintos fork 규약). 부모 안에서 dup2로 하나의 파일을
+ * 공유하던 fd들은 자식에서도 하나의 복제본을 공유한다. 참조가 둘 이상인 파일만 대응표에 넣어
+ * fd 수에 비례하는 시간에 끝난다. file_lock을 잡은 상태로 호출한다. */
+bool
+fd_table_duplicate(struct thread *parent, struct thread *child) {
+    struct fd_copy *copies = NULL;
+    size_t shared = 0, cap = 1;
+    bool ok = true;
+
+    if(parent->fd_cap == 0) return true;
+    if(!fd_table_grow(child, parent->fd_cap)) return false;
+
+    for(int i = 0; i < parent->fd_cap; i++) {
+        struct file *file = parent->fd_table[i];
+        if(file != NULL && !is_console(file) && file_is_shared(file)) shared++;
+    }
+    if(shared > 0) {
+        while(cap < 2 * shared) cap *= 2;
+        copies = calloc(cap, sizeof *copies);
+        if(copies == NULL) return false;
+    }
+
+    for(int i = 0; i < parent->fd_cap; i++) {
+        struct file *file = parent->fd_table[i];
+        struct file *copy = file;
+
+        if(file != NULL && !is_console(file)) {
+            struct fd_copy *slot = file_is_shared(file) ? fd_copy_slot(copies, cap, file) : NULL;
+            if(slot != NULL && slot->file != NULL)
+                copy = file_share(slot->copy);
+            else {
+                copy = file_duplicate(file);
+                if(slot != NULL && copy != NULL) *slot = (struct fd_copy) { file, copy };
+            }
+            if(copy == NULL) {
+                ok = false;
+                break;
+            }
+        }
+        child->fd_table[i] = copy;
+        if(copy != NULL) bitmap_mark(child->fd_map, i);
+    }
+    free(copies);
+    return ok;
 }
+
+
+/* T의 fd table에 남아있는 파일을 모두 닫고 table을 해제한다. file_lock을 잡은 상태로 호출한다. */
+void
+fd_table_destroy(struct thread *t) {
+    for(int i = 0; i < t->fd_cap; i++) {
+        if(!is_console(t->fd_table[i])) file_close(t->fd_table[i]);
+    }
+    if(t->fd_table != NULL)
+        palloc_free_multiple(t->fd_table, t->fd_cap / FD_PAGE_SLOTS);
+    bitmap_destroy(t->fd_map);
+    t->fd_table = NULL;
+    t->fd_map = NULL;
+    t->fd_cap = 0;
+}
+
@@ -0,0 +1,415 @@
+#include "userprog/uring.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include <uring.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/exception.h"
+#include "userprog/syscall.h"
+#include "vm/vm.h"
+
+/* Kernel side of a process's rings.
+
+   uring_enter() runs in the process.  It copies each SQE into the
+   kernel, handles open and close on the spot, and hands reads and
+   writes to the process's worker thread as struct uring_reqs.
+   The worker takes everything queued so far as one batch, does it
+   under a single file_lock hold and posts the completions.  The
+   process later reaps finished requests, which unpins their
+   buffers. */
+struct uring_ctx {
+	struct uring *ring;         /* Kernel address of the shared ring. */
+	size_t page_cnt;            /* Pages in the shared ring. */
+	unsigned sq_entries;        /* Kernel copies of the ring geometry; */
+	unsigned cq_entries;        /* the process may rewrite the header's. */
+	uint64_t *pml4;             /* Owning process's page table. */
+
+	struct lock lock;           /* Protects the members below. */
+	struct list pending;        /* Requests for the worker. */
+	struct list done;           /* Completed, not yet reaped. */
+	unsigned inflight;          /* Submitted, completion not posted. */
+	bool dying;                 /* Worker should exit when idle. */
+	struct condition work;      /* Signaled when PENDING grows. */
+	struct condition complete;  /* Signaled when completions post. */
+	struct semaphore exited;    /* Upped by the worker on exit. */
+};
+
+/* A read or write handed to the worker. */
+struct uring_req {
+	struct list_elem elem;
+	bool write;                 /* Write (true) or read (false)? */
+	struct file *file;          /* Private reopen of the target file. */
+	uint8_t *buf;               /* User buffer, pinned. */
+	size_t len;                 /* Buffer length. */
+	off_t ofs;                  /* File offset. */
+	uint64_t user_data;         /* For the completion. */
+	int res;                    /* Result. */
+};
+
+static void uring_worker (void *ctx_);
+static void post_cqe (struct uring_ctx *, uint64_t user_data, int res);
+static void reap (struct uring_ctx *);
+static bool submit (struct uring_ctx *, const struct uring_sqe *, int *res);
+
+/* Sets up a ring with at least ENTRIES submission entries for the
+   running process, maps it at URING_ADDR and starts its worker.
+   Returns URING_ADDR, or NULL on failure or if the process
+   already has a ring. */
+void *
+uring_setup (unsigned entries) {
+	struct thread *t = thread_current ();
+	struct uring_ctx *ctx;
+	unsigned sq_entries = 1;
+	size_t i;
+
+	if (t->uring != NULL || entries == 0 || entries > URING_MAX_ENTRIES)
+		return NULL;
+	while (sq_entries < entries)
+		sq_entries *= 2;
+
+	ctx = malloc (sizeof *ctx);
+	if (ctx == NULL)
+		return NULL;
+	ctx->page_cnt = DIV_ROUND_UP (URING_SIZE (sq_entries), PGSIZE);
+	ctx->ring = palloc_get_multiple (PAL_ZERO, ctx->page_cnt);
+	if (ctx->ring == NULL) {
+		free (ctx);
+		return NULL;
+	}
+	ctx->sq_entries = sq_entries;
+	ctx->cq_entries = 2 * sq_entries;
+	ctx->ring->sq_entries = ctx->sq_entries;
+	ctx->ring->cq_entries = ctx->cq_entries;
+	ctx->pml4 = t->pml4;
+	lock_init (&ctx->lock);
+	list_init (&ctx->pending);
+	list_init (&ctx->done);
+	ctx->inflight = 0;
+	ctx->dying = false;
+	cond_init (&ctx->work);
+	cond_init (&ctx->complete);
+	sema_init (&ctx->exited, 0);
+
+	for (i = 0; i < ctx->page_cnt; i++)
+		if (!pml4_set_page (t->pml4, (uint8_t *) URING_ADDR + i * PGSIZE,
+					(uint8_t *) ctx->ring + i * PGSIZE, true))
+			goto error;
+	if (thread_create ("uring", PRI_DEFAULT, uring_worker, ctx) == TID_ERROR)
+		goto error;
+
+	t->uring = ctx;
+	return URING_ADDR;
+
+error:
+	for (i = 0; i < ctx->page_cnt; i++)
+		pml4_clear_page (t->pml4, (uint8_t *) URING_ADDR + i * PGSIZE);
+	palloc_free_multiple (ctx->ring, ctx->page_cnt);
+	free (ctx);
+	return NULL;
+}
+
+/* Submits up to TO_SUBMIT queued SQEs of the running process's
+   ring, then waits until at least MIN_COMPLETE CQEs are waiting
+   to be consumed.  Returns the number of SQEs consumed, or -1 if
+   the process has no ring. */
+int
+uring_enter (unsigned to_submit, unsigned min_complete) {
+	struct uring_ctx *ctx = thread_current ()->uring;
+	struct uring *ring;
+	int submitted = 0;
+
+	if (ctx == NULL)
+		return -1;
+	ring = ctx->ring;
+	if (min_complete > ctx->cq_entries)
+		min_complete = ctx->cq_entries;
+
+	lock_acquire (&ctx->lock);
+	reap (ctx);
+	while ((unsigned) submitted < to_submit && ring->sq_head != ring->sq_tail
+			/* Leave room in the CQ for everything in flight. */
+			&& ring->cq_tail - ring->cq_head + ctx->inflight < ctx->cq_entries) {
+		struct uring_sqe sqe =
+			URING_SQES (ring)[ring->sq_head & (ctx->sq_entries - 1)];
+		ring->sq_head++;
+		submitted++;
+
+		lock_release (&ctx->lock);
+		int res;
+		bool queued = submit (ctx, &sqe, &res);
+		lock_acquire (&ctx->lock);
+		if (!queued)
+			post_cqe (ctx, sqe.user_data, res);
+	}
+	if (!list_empty (&ctx->pending))
+		cond_signal (&ctx->work, &ctx->lock);
+
+	while (ring->cq_tail - ring->cq_head < min_complete && ctx->inflight > 0)
+		cond_wait (&ctx->complete, &ctx->lock);
+	reap (ctx);
+	lock_release (&ctx->lock);
+
+	return submitted;
+}
+
+/* Waits until T's worker has finished every request submitted so
+   far, so that their buffers may be unmapped. */
+void
+uring_quiesce (struct thread *t) {
+	struct uring_ctx *ctx = t->uring;
+
+	if (ctx == NULL)
+		return;
+	lock_acquire (&ctx->lock);
+	while (ctx->inflight > 0)
+		cond_wait (&ctx->complete, &ctx->lock);
+	reap (ctx);
+	lock_release (&ctx->lock);
+}
+
+/* Stops T's worker after its outstanding requests, then unmaps
+   and frees T's ring.  Must run in T before its page table is
+   destroyed. */
+void
+uring_destroy (struct thread *t) {
+	struct uring_ctx *ctx = t->uring;
+	size_t i;
+
+	if (ctx == NULL)
+		return;
+
+	lock_acquire (&ctx->lock);
+	ctx->dying = true;
+	cond_signal (&ctx->work, &ctx->lock);
+	lock_release (&ctx->lock);
+	sema_down (&ctx->exited);
+
+	lock_acquire (&ctx->lock);
+	reap (ctx);
+	lock_release (&ctx->lock);
+
+	for (i = 0; i < ctx->page_cnt; i++)
+		pml4_clear_page (ctx->pml4, (uint8_t *) URING_ADDR + i * PGSIZE);
+	palloc_free_multiple (ctx->ring, ctx->page_cnt);
+	free (ctx);
+	t->uring = NULL;
+}
+
+/* Posts a completion for USER_DATA with result RES.
+   CTX's lock must be held. */
+static void
+post_cqe (struct uring_ctx *ctx, uint64_t user_data, int res) {
+	struct uring *ring = ctx->ring;
+	struct uring_cqe *cqes = URING_CQES (ring, ctx->sq_entries);
+	struct uring_cqe *cqe = &cqes[ring->cq_tail & (ctx->cq_entries - 1)];
+
+	cqe->user_data = user_data;
+	cqe->res = res;
+	barrier ();
+	ring->cq_tail++;
+}
+
+/* Frees CTX's completed requests, unpinning their buffers.
+   Runs in the owning process with CTX's lock held. */
+static void
+reap (struct uring_ctx *ctx) {
+	while (!list_empty (&ctx->done)) {
+		struct uring_req *req =
+			list_entry (list_pop_front (&ctx->done), struct uring_req, elem);
+		vm_unpin_range (req->buf, req->len);
+		free (req);
+	}
+}
+
+/* Returns true if every page of [BUF, BUF + LEN) is resident in
+   the running process, and writable if WRITABLE is true.  The
+   worker reaches the buffer through the page table, so it can't
+   take page faults on it. */
+static bool
+buffer_resident (const uint8_t *buf, size_t len, bool writable) {
+	struct thread *t = thread_current ();
+	const uint8_t *va;
+
+	if (len == 0)
+		return true;
+	if (!is_user_vaddr (buf) || len > KERN_BASE - (uint64_t) buf)
+		return false;
+	for (va = pg_round_down (buf); va < buf + len; va += PGSIZE) {
+		struct page *page = spt_find_page (&t->spt, (void *) va);
+		if (page == NULL || page->frame == NULL
+				|| (writable && !page->writable))
+			return false;
+	}
+	return true;
+}
+
+/* Starts SQE.  Reads and writes are queued for the worker, which
+   posts their completions; returns true for those.  Anything else
+   is done right away: returns false and stores the result to post
+   in *RES. */
+static bool
+submit (struct uring_ctx *ctx, const struct uring_sqe *sqe, int *res) {
+	struct uring_req *req;
+	struct file *file;
+	char name[128];
+
+	*res = -1;
+	switch (sqe->opcode) {
+		case URING_OP_NOP:
+			*res = 0;
+			return false;
+
+		case URING_OP_OPEN:
+			if (copy_str_from_user (name, (const char *) sqe->addr,
+						sizeof name) < 0)
+				return false;
+			lock_acquire (&file_lock);
+			file = filesys_open (name);
+			lock_release (&file_lock);
+			if (file == NULL)
+				return false;
+			*res = fd_table_insert (file);
+			if (*res == -1) {
+				lock_acquire (&file_lock);
+				file_close (file);
+				lock_release (&file_lock);
+			}
+			return false;
+
+		case URING_OP_CLOSE:
+			file = fd_table_get_file (sqe->fd);
+			if (file == NULL)
+				return false;
+			lock_acquire (&file_lock);
+			file_close (file);
+			lock_release (&file_lock);
+			fd_table_remove (sqe->fd);
+			*res = 0;
+			return false;
+
+		case URING_OP_READ:
+		case URING_OP_WRITE:
+			file = fd_table_get_file (sqe->fd);
+			if (file == NULL || sqe->off < 0 || sqe->len > INT32_MAX)
+				return false;
+
+			/* Pin the buffer here, where it can still fault in,
+			   and make sure the worker will find it resident. */
+			vm_pin_range ((void *) sqe->addr, sqe->len);
+			if (!buffer_resident ((void *) sqe->addr, sqe->len,
+						sqe->opcode == URING_OP_READ)) {
+				vm_unpin_range ((void *) sqe->addr, sqe->len);
+				return false;
+			}
+
+			/* The worker uses its own reopen of the file, so a
+			   close submitted meanwhile can't pull it away. */
+			req = malloc (sizeof *req);
+			if (req != NULL) {
+				lock_acquire (&file_lock);
+				req->file = file_reopen (file);
+				lock_release (&file_lock);
+			}
+			if (req == NULL || req->file == NULL) {
+				free (req);
+				vm_unpin_range ((void *) sqe->addr, sqe->len);
+				return false;
+			}
+			req->write = sqe->opcode == URING_OP_WRITE;
+			req->buf = (uint8_t *) sqe->addr;
+			req->len = sqe->len;
+			req->ofs = sqe->off;
+			req->user_data = sqe->user_data;
+
+			lock_acquire (&ctx->lock);
+			list_push_back (&ctx->pending, &req->elem);
+			ctx->inflight++;
+			lock_release (&ctx->lock);
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/* Performs REQ through CTX's page table.  file_lock must be held. */
+static int
+do_req (struct uring_ctx *ctx, struct uring_req *req) {
+	size_t done = 0;
+
+	while (done < req->len) {
+		uint8_t *uaddr = req->buf + done;
+		size_t chunk = PGSIZE - pg_ofs (uaddr);
+		uint8_t *kaddr = pml4_get_page (ctx->pml4, uaddr);
+		off_t n;
+
+		if (kaddr == NULL)
+			return -1;
+		if (chunk > req->len - done)
+			chunk = req->len - done;
+		n = req->write
+			? file_write_at (req->file, kaddr, chunk, req->ofs + done)
+			: file_read_at (req->file, kaddr, chunk, req->ofs + done);
+		/* Writing through the kernel alias leaves the user PTE
+		   clean, so mark it dirty for mmap write-back to see. */
+		if (!req->write && n > 0)
+			pml4_set_dirty (ctx->pml4, uaddr, true);
+		done += n;
+		if ((size_t) n < chunk)
+			break;
+	}
+	return done;
+}
+
+/* The worker thread for CTX.  Takes every pending request as one
+   batch, performs the batch under a single file_lock hold and
+   posts its completions, until told to exit. */
+static void
+uring_worker (void *ctx_) {
+	struct uring_ctx *ctx = ctx_;
+	struct list batch;
+
+	list_init (&batch);
+	lock_acquire (&ctx->lock);
+	for (;;) {
+		struct list_elem *e;
+
+		while (list_empty (&ctx->pending) && !ctx->dying)
+			cond_wait (&ctx->work, &ctx->lock);
+		if (list_empty (&ctx->pending))
+			break;
+
+		/* Take the whole queue. */
+		while (!list_empty (&ctx->pending))
+			list_push_back (&batch, list_pop_front (&ctx->pending));
+		lock_release (&ctx->lock);
+
+		lock_acquire (&file_lock);
+		for (e = list_begin (&batch); e != list_end (&batch); e = list_next (e)) {
+			struct uring_req *req = list_entry (e, struct uring_req, elem);
+			req->res = do_req (ctx, req);
+			file_close (req->file);
+		}
+		lock_release (&file_lock);
+
+		lock_acquire (&ctx->lock);
+		while (!list_empty (&batch)) {
+			struct uring_req *req =
+				list_entry (list_pop_front (&batch), struct uring_req, elem);
+			post_cqe (ctx, req->user_data, req->res);
+			list_push_back (&ctx->done, &req->elem);
+			ctx->inflight--;
+		}
+		cond_broadcast (&ctx->complete, &ctx->lock);
+	}
+	lock_release (&ctx->lock);
+	sema_up (&ctx->exited);
+}
@@ -0,0 +1,93 @@
+#include "userprog/vdso.h"
+#include <debug.h>
+#include <vdso.h>
+#include "devices/timer.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The page behind VDSO_DATA, shared by every process. */
+static struct vdso_data *data;
+
+static inline uint64_t
+rdtsc (void) {
+	uint32_t lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* Allocates the shared data page. */
+void
+vdso_init (void) {
+	ASSERT ((uint64_t) VDSO_DATA == USER_STACK);
+
+	data = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	data->timer_freq = TIMER_FREQ;
+}
+
+/* Publishes the tick count TICKS.  Called by the timer interrupt.
+   The TSC rate is estimated from the TSC delta between ticks,
+   smoothed so that one late interrupt does not throw it off. */
+void
+vdso_tick (int64_t ticks) {
+	uint64_t tsc = rdtsc ();
+
+	if (data == NULL)
+		return;
+
+	data->seq++;
+	barrier ();
+	if (data->tick_tsc != 0) {
+		uint64_t delta = tsc - data->tick_tsc;
+		data->tsc_per_tick = data->tsc_per_tick == 0
+			? delta : (data->tsc_per_tick * 7 + delta) / 8;
+	}
+	data->tick_tsc = tsc;
+	data->ticks = ticks;
+	barrier ();
+	data->seq++;
+}
+
+/* Maps the vDSO pages read-only into PML4, with PID as the
+   process's pid.  Returns true if successful, false on failure. */
+bool
+vdso_map (uint64_t *pml4, int pid) {
+	struct vdso_proc *proc = palloc_get_page (PAL_ZERO);
+
+	if (proc == NULL)
+		return false;
+	proc->pid = pid;
+
+	if (!pml4_set_page (pml4, (void *) VDSO_DATA, data, false)
+			|| !pml4_set_page (pml4, (void *) VDSO_PROC, proc, false)) {
+		pml4_clear_page (pml4, (void *) VDSO_DATA);
+		palloc_free_page (proc);
+		return false;
+	}
+	return true;
+}
+
+/* Removes the vDSO pages from PML4 and frees its private page.
+   Must be called before pml4_destroy(), which would otherwise
+   free the shared page along with the process's own pages. */
+void
+vdso_unmap (uint64_t *pml4) {
+	struct vdso_proc *proc = pml4_get_page (pml4, VDSO_PROC);
+
+	pml4_clear_page (pml4, (void *) VDSO_DATA);
+	if (proc != NULL) {
+		pml4_clear_page (pml4, (void *) VDSO_PROC);
+		palloc_free_page (proc);
+	}
+}
+
+/* Makes PID the pid that PML4's vDSO reports.  Used while a vfork
+   child runs in its parent's address space. */
+void
+vdso_set_pid (uint64_t *pml4, int pid) {
+	struct vdso_proc *proc = pml4_get_page (pml4, VDSO_PROC);
+
+	if (proc != NULL)
+		proc->pid = pid;
+}
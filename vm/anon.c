@@ -58,5 +58,5 @@ anon_destroy (struct page *page) {
 	if (page->frame){
 		page->frame->page = NULL;		
 	}
-	free(page->frame);
+	kmem_cache_free(frame_slab, page->frame);
 }
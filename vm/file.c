@@ -60,10 +60,10 @@ file_backed_swap_in (struct page *page, void *kva) {
 	size_t page_zero_bytes = aux->page_zero_bytes;
 	
 	/* Load this page. */
-	if (file_read_at (file, page->va, page_read_bytes, ofs) != (int) page_read_bytes)
+	if (file_read_at (file, kva, page_read_bytes, ofs) != (int) page_read_bytes)
 		return false;
 
-	memset (page->va + page_read_bytes, 0, page_zero_bytes);
+	memset (kva + page_read_bytes, 0, page_zero_bytes);
 
 	/* Set dirty bit to old one. */
 	pml4_set_dirty (thread_current()->pml4, page->va, 0);
@@ -84,7 +84,7 @@ file_backed_destroy (struct page *page) {
 	if (page->frame){
 	page->frame->page = NULL;		
 	}
-	free(page->frame);
+	kmem_cache_free(frame_slab, page->frame);
 }
 
 /* Do the mmap */
@@ -119,7 +119,9 @@ do_mmap (void *addr, size_t length, int writable,struct file *file, off_t offset
 
 		/* Setup auxiliary data. We will use reopened file
 		   because file may closed or removed by other process.*/
-		struct aux_data *aux = calloc (1, sizeof(struct aux_data));
+		struct aux_data *aux = kmem_cache_alloc (aux_slab);
+		if (aux == NULL)
+			PANIC("do_mmap: aux_data allocation failed.");
 		aux->file = file;
 		aux->ofs = offset;
 		aux->page_read_bytes = page_read_bytes;
@@ -168,9 +170,11 @@ do_munmap (void *addr) {
 		if (page->frame) {
 			/* If the page is dirty, write back to the file. */
 			if (pml4_is_dirty (pml4, addr)){
+				page->frame->pinned++;
 				lock_acquire(&file_lock);
 				file_write_at (file, addr, aux->page_read_bytes, aux->ofs);
 				lock_release(&file_lock);
+				page->frame->pinned--;
 			}
 			/* Remove page from pml4. */
 			pml4_clear_page (pml4, addr);
@@ -7,6 +7,9 @@
 #include "vm/inspect.h"
 #include "threads/mmu.h"
 
+struct kmem_cache *page_slab;
+struct kmem_cache *frame_slab;
+struct kmem_cache *aux_slab;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -20,6 +23,9 @@ vm_init (void) {
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	page_slab = kmem_cache_create ("page", sizeof (struct page), NULL);
+	frame_slab = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+	aux_slab = kmem_cache_create ("aux_data", sizeof (struct aux_data), NULL);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -58,9 +64,11 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		         and then create "uninit" page struct by calling uninit_new. You
 		         should modify the field after calling the uninit_new. */
 
-		struct page * page = (struct page*)malloc(sizeof(struct page)) ;
+		struct page * page = (struct page*)kmem_cache_alloc(page_slab) ;
 		bool (*initializer)(struct page *, enum vm_type, void *) ; 
 		
+		if (page == NULL)
+			goto err ;
 
 		if (VM_TYPE(type) == VM_ANON) {
 			initializer = anon_initializer;
@@ -89,41 +97,153 @@ err:
 }
 
 
+/* SPT hash table helpers. */
+
+/* Initial number of slots, allocated on the first insert. */
+#define SPT_MIN_CAPACITY 16
+
+/* Slot index returned when a page is not in the table. */
+#define SPT_NONE SIZE_MAX
+
+/* Returns the home slot of page-aligned VA in H. Fibonacci hashing
+ * of the page number spreads consecutive pages across the table. */
+static inline size_t
+spt_home (const struct spt_hash *h, const void *va) {
+	return (size_t) ((pg_no (va) * 0x9e3779b97f4a7c15ULL) >> 32)
+		& (h->capacity - 1);
+}
+
+/* Returns how far the entry in slot IDX of H is from its home. */
+static inline size_t
+spt_dist (const struct spt_hash *h, size_t idx) {
+	return (idx - spt_home (h, h->slots[idx].va)) & (h->capacity - 1);
+}
+
+/* Returns the slot index holding page-aligned VA in H,
+ * or SPT_NONE if there is none. */
+static size_t
+spt_slot_lookup (const struct spt_hash *h, const void *va) {
+	size_t idx, dist;
+
+	if (h->cnt == 0 || va == NULL)
+		return SPT_NONE;
+	for (idx = spt_home (h, va), dist = 0; ; idx = (idx + 1) & (h->capacity - 1), dist++) {
+		const struct spt_slot *s = &h->slots[idx];
+		if (s->va == va)
+			return idx;
+		/* An empty slot, or an entry closer to home than we are,
+		 * means VA would have been placed before here. */
+		if (s->va == NULL || spt_dist (h, idx) < dist)
+			return SPT_NONE;
+	}
+}
+
+/* Places ENTRY into H, which must have a free slot and must not
+ * contain ENTRY's VA. */
+static void
+spt_slot_place (struct spt_hash *h, struct spt_slot entry) {
+	size_t idx = spt_home (h, entry.va);
+	size_t dist = 0;
+
+	for (;; idx = (idx + 1) & (h->capacity - 1), dist++) {
+		struct spt_slot *s = &h->slots[idx];
+		size_t s_dist;
+
+		if (s->va == NULL) {
+			*s = entry;
+			h->cnt++;
+			return;
+		}
+		/* Robin Hood: the entry farther from home takes the slot. */
+		s_dist = spt_dist (h, idx);
+		if (s_dist < dist) {
+			struct spt_slot tmp = *s;
+			*s = entry;
+			entry = tmp;
+			dist = s_dist;
+		}
+	}
+}
+
+/* Resizes H to NEW_CAPACITY slots. Returns false if memory
+ * allocation fails, in which case H is unchanged. */
+static bool
+spt_resize (struct spt_hash *h, size_t new_capacity) {
+	struct spt_slot *old_slots = h->slots;
+	size_t old_capacity = h->capacity;
+	size_t i;
+
+	h->slots = calloc (new_capacity, sizeof *h->slots);
+	if (h->slots == NULL) {
+		h->slots = old_slots;
+		return false;
+	}
+	h->capacity = new_capacity;
+	h->cnt = 0;
+	for (i = 0; i < old_capacity; i++)
+		if (old_slots[i].va != NULL)
+			spt_slot_place (h, old_slots[i]);
+	free (old_slots);
+	return true;
+}
+
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
 spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	/* TODO: Fill this function. */
-	struct page p;
-	struct hash_elem *e;
+	struct spt_hash *h = &spt->hash_spt;
+	size_t idx = spt_slot_lookup (h, pg_round_down (va));
 
-	p.va = pg_round_down(va);
-	e = hash_find (&spt->hash_spt, &p.hash_elem); 
-	return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+	return idx != SPT_NONE ? h->slots[idx].page : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
 spt_insert_page (struct supplemental_page_table *spt UNUSED,
 		struct page *page UNUSED) {
-	struct hash_elem *result = hash_insert (&spt->hash_spt, &page->hash_elem); // null이면 성공인 것 
-	return result == NULL ? true : false ; 
+	struct spt_hash *h = &spt->hash_spt;
+
+	ASSERT (pg_ofs (page->va) == 0);
+	if (page->va == NULL || spt_slot_lookup (h, page->va) != SPT_NONE)
+		return false;
+
+	/* Keep the load factor at or below 7/8. */
+	if ((h->cnt + 1) * 8 > h->capacity * 7
+			&& !spt_resize (h, h->capacity ? h->capacity * 2 : SPT_MIN_CAPACITY))
+		return false;
+
+	spt_slot_place (h, (struct spt_slot) { .va = page->va, .page = page });
+	return true;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
-	struct hash_elem * result =	hash_delete (&spt->hash_spt, &page->hash_elem);
-	if (result == NULL) {
-		return false; 
+	struct spt_hash *h = &spt->hash_spt;
+	size_t idx, next;
+
+	if (page == NULL || (idx = spt_slot_lookup (h, page->va)) == SPT_NONE)
+		return;
+
+	/* Backward-shift deletion: pull following entries one slot
+	 * closer to home until one is already at home. */
+	for (;; idx = next) {
+		next = (idx + 1) & (h->capacity - 1);
+		if (h->slots[next].va == NULL || spt_dist (h, next) == 0)
+			break;
+		h->slots[idx] = h->slots[next];
 	}
+	h->slots[idx].va = NULL;
+	h->slots[idx].page = NULL;
+	h->cnt--;
+
 	vm_dealloc_page (page);
-	return true;
 }
 
 /* Get the struct frame, that will be evicted. */
 static struct frame *
 vm_get_victim (void) {
 	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	 /* TODO: The policy for eviction is up to you.
+	  * Frames with PINNED set are in use by a system call and must be skipped. */
 
 	return victim;
 }
@@ -151,9 +271,10 @@ vm_get_frame (void) {
 	if (kva == NULL) {
 		 PANIC ("no memory. evict & swap out 필요 ");
 	}
-	struct frame *frame = (struct frame *)malloc(sizeof(struct frame));
+	struct frame *frame = (struct frame *)kmem_cache_alloc(frame_slab);
 	frame->kva = kva ;
 	frame->page = NULL ; 
+	frame->pinned = 0 ;
 
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
@@ -207,13 +328,50 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 return vm_do_claim_page (page);
 }
 
+/* Pin the frames of the user pages covering [UADDR, UADDR + SIZE) so the evictor
+ * leaves them alone until vm_unpin_range (). Pages that are not resident yet are
+ * claimed first, so the I/O that follows does not fault on them while holding
+ * file_lock. Pages missing from the SPT are skipped and left to the fault path
+ * (stack growth or copy_to_user () failure). */
+void
+vm_pin_range (const void *uaddr, size_t size) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+
+	if (size == 0 || !is_user_vaddr (uaddr) || size > KERN_BASE - (uint64_t) uaddr)
+		return;
+	for (void *va = pg_round_down (uaddr); va < uaddr + size; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+		if (page == NULL)
+			continue;
+		if (page->frame == NULL && !vm_do_claim_page (page))
+			continue;
+		page->frame->pinned++;
+	}
+}
+
+/* Drop one pin from each frame pinned by vm_pin_range (UADDR, SIZE). The pin is
+ * a count, so a range pinned by two callers at once (say, a uring request and a
+ * read() into the same page) stays pinned until both are done. */
+void
+vm_unpin_range (const void *uaddr, size_t size) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+
+	if (size == 0 || !is_user_vaddr (uaddr) || size > KERN_BASE - (uint64_t) uaddr)
+		return;
+	for (void *va = pg_round_down (uaddr); va < uaddr + size; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+		if (page != NULL && page->frame != NULL && page->frame->pinned > 0)
+			page->frame->pinned--;
+	}
+}
+
 /* Free the page.
  * DO NOT MODIFY THIS FUNCTION. */
 void
 vm_dealloc_page (struct page *page) {
 	
 	destroy (page);
-	free (page);
+	kmem_cache_free (page_slab, page);
 }
 
 /* Claim the page that allocate on VA. 
@@ -248,24 +406,19 @@ vm_do_claim_page (struct page *page) {
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
-	struct thread *curr = thread_current() ;
-	hash_init (&curr->spt.hash_spt, page_hash, page_less, NULL); 
+	spt->hash_spt = (struct spt_hash) { .slots = NULL, .capacity = 0, .cnt = 0 };
 	lock_init(&spt->spt_lock);
 }
 
 /* Copy supplemental page table from src to dst */
 bool
 supplemental_page_table_copy (struct supplemental_page_table *dst, struct supplemental_page_table *src ) {
-struct hash *parent_hash = &src->hash_spt ; // 
-struct hash *curr_hash = &dst->hash_spt ; 
-struct list *parent_list = &src->mmap_list;
-struct list *curr_list = &dst->mmap_list; 
-
-struct hash_iterator i;
-hash_first (&i, parent_hash);
-while (hash_next (&i)) {
-    struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
-	enum vm_type type = page_get_type(p);
+struct spt_hash *parent_hash = &src->hash_spt ; // 
+
+for (size_t i = 0; i < parent_hash->capacity; i++) {
+    struct page *p = parent_hash->slots[i].page;
+	if (p == NULL)
+		continue;
 	enum vm_type fulltype = p->full_type;
 	void *va = p-> va; 
 	bool writable = p-> writable;  
@@ -273,8 +426,7 @@ while (hash_next (&i)) {
 	if (p->operations->type == VM_UNINIT) {
 	// 초기화 안 된 페이지
 		vm_initializer *init = p->uninit.init; 
-		struct aux_data *aux = malloc(sizeof(struct aux_data));
-		aux = p->uninit.aux; 
+		struct aux_data *aux = p->uninit.aux; 
 		if(!vm_alloc_page_with_initializer(fulltype, va, writable, init, aux))
 			return false;
 	} 	
@@ -286,12 +438,26 @@ while (hash_next (&i)) {
 		if (!vm_claim_page(va)) {
 			return false;
 		}
-		memcpy(va, p->frame->kva, PGSIZE);// 실제 메모리 내용 복사
+		memcpy(spt_find_page(dst, va)->frame->kva, p->frame->kva, PGSIZE);// 실제 메모리 내용 복사
 	}     
 	}
 	return true;
 }
 
+/* Move every page of SRC into DST, which must be empty, leaving SRC empty.
+ * Used by vfork to lend a process's address space to its child and back. */
+void
+supplemental_page_table_move (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	ASSERT (dst->hash_spt.cnt == 0 && list_empty (&dst->mmap_list));
+
+	free (dst->hash_spt.slots);
+	dst->hash_spt = src->hash_spt;
+	src->hash_spt = (struct spt_hash) { .slots = NULL, .capacity = 0, .cnt = 0 };
+	while (!list_empty (&src->mmap_list))
+		list_push_back (&dst->mmap_list, list_pop_front (&src->mmap_list));
+}
+
 /* Free the resource hold by the supplemental page table */
 void
 supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
@@ -305,7 +471,11 @@ supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 		ASSERT (page->page_cnt != 0);
 		do_munmap (page->va);
 	}
-	/* Destroy and re-init hash table. */
-	struct hash *h = &spt->hash_spt;
-	hash_clear (&spt->hash_spt, clear_func);
+	/* Destroy all pages and re-init hash table. */
+	struct spt_hash *h = &spt->hash_spt;
+	for (size_t i = 0; i < h->capacity; i++)
+		if (h->slots[i].page != NULL)
+			vm_dealloc_page (h->slots[i].page);
+	free (h->slots);
+	*h = (struct spt_hash) { .slots = NULL, .capacity = 0, .cnt = 0 };
 }